@@ -0,0 +1,782 @@
+/**
+	\file apps/obex_bench/obex_bench.c
+	End-to-end throughput and latency benchmark over local transports.
+	OpenOBEX test applications and sample code.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as
+	published by the Free Software Foundation; either version 2 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#define _GNU_SOURCE
+
+#include <openobex/obex.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+/* A client and a server handle are connected through one of the transports
+ * below. The server runs in its own thread. The client does a number of
+ * PUT requests for every combination of MTU, object size, response mode
+ * and body mode, and the results are printed as JSON. */
+
+#define BENCH_STREAM_CHUNK	65536
+#define BENCH_MIN_REQUESTS	16
+#define BENCH_MAX_REQUESTS	10000
+#define BENCH_TARGET_BYTES	(64 * 1024 * 1024)
+#define BENCH_TIMEOUT		30	/* seconds per request */
+
+enum bench_transport {
+	BENCH_TCP,
+	BENCH_FD,
+	BENCH_CUSTOM,
+	BENCH_LOOP,
+};
+
+static const char *transport_names[] = {
+	[BENCH_TCP] = "tcp",
+	[BENCH_FD] = "fd",
+	[BENCH_CUSTOM] = "custom",
+	[BENCH_LOOP] = "loop",
+};
+
+struct bench_config {
+	enum bench_transport transport;
+	unsigned int mtu;
+	size_t size;
+	int srm;
+	int stream;
+	unsigned int requests;
+	size_t spill;			/* server body spill threshold */
+};
+
+/* State of one end of the connection */
+struct bench_peer {
+	obex_t *handle;
+	int fd;				/* socket of custom transport */
+	uint8_t rxbuf[BENCH_STREAM_CHUNK];
+
+	int srm;
+	int stream;
+
+	/* client */
+	const uint8_t *data;
+	size_t size;
+	size_t sent;
+	int done;
+	int rsp;
+	unsigned long packets;
+
+	/* server */
+	volatile int finished;
+	unsigned long long received;
+};
+
+struct bench_result {
+	double seconds;
+	double cpu_seconds;
+	unsigned long long bytes;
+	unsigned long packets;
+	double p50_us;
+	double p99_us;
+	obex_stats_t stats;		/* client handle during the requests */
+	obex_latency_summary_t put[OBEX_LATENCY_PHASES]; /* same, by phase */
+	int ok;
+};
+
+static unsigned short tcp_port = 36650;
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double cpu_seconds(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6 +
+		(double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+}
+
+/*
+ * Custom transport over a socket pair
+ */
+static int ctrans_connect(obex_t *handle, void *customdata)
+{
+	return 1;
+}
+
+static int ctrans_disconnect(obex_t *handle, void *customdata)
+{
+	return 1;
+}
+
+static int ctrans_write(obex_t *handle, void *customdata, uint8_t *buf,
+			int buflen)
+{
+	struct bench_peer *peer = customdata;
+	int done = 0;
+
+	while (done < buflen) {
+		ssize_t ret = send(peer->fd, buf + done, buflen - done,
+				   MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += ret;
+	}
+	return done;
+}
+
+static int ctrans_handleinput(obex_t *handle, void *customdata, int timeout)
+{
+	struct bench_peer *peer = customdata;
+	struct pollfd pfd = { peer->fd, POLLIN, 0 };
+	ssize_t ret;
+
+	ret = poll(&pfd, 1, timeout * 1000);
+	if (ret <= 0)
+		return (int)ret;
+
+	ret = recv(peer->fd, peer->rxbuf, sizeof(peer->rxbuf), 0);
+	if (ret <= 0)
+		return -1;
+
+	return OBEX_CustomDataFeed(handle, peer->rxbuf, (int)ret) < 0? -1: 1;
+}
+
+/*
+ * Server
+ */
+static void server_event(obex_t *handle, obex_object_t *object, int mode,
+			 int event, int obex_cmd, int obex_rsp)
+{
+	struct bench_peer *peer = OBEX_GetUserData(handle);
+	const uint8_t *buf;
+	int len;
+
+	switch (event) {
+	case OBEX_EV_REQHINT:
+		OBEX_ObjectSetRsp(object, OBEX_RSP_CONTINUE, OBEX_RSP_SUCCESS);
+		if (obex_cmd == OBEX_CMD_PUT) {
+			if (peer->srm)
+				OBEX_SetReponseMode(handle,
+						    OBEX_RSP_MODE_SINGLE);
+			if (peer->stream)
+				OBEX_ObjectReadStream(handle, object, NULL);
+		}
+		break;
+
+	case OBEX_EV_STREAMAVAIL:
+		len = OBEX_ObjectReadStream(handle, object, &buf);
+		if (len > 0)
+			peer->received += len;
+		break;
+
+	case OBEX_EV_REQ:
+		/* A buffered body is complete now */
+		if (obex_cmd == OBEX_CMD_PUT && !peer->stream) {
+			len = OBEX_ObjectReadStream(handle, object, &buf);
+			if (len > 0)
+				peer->received += len;
+		}
+		break;
+
+	case OBEX_EV_REQDONE:
+		if (obex_cmd == OBEX_CMD_DISCONNECT)
+			peer->finished = 1;
+		break;
+
+	case OBEX_EV_LINKERR:
+	case OBEX_EV_PARSEERR:
+		peer->finished = 1;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void * server_thread(void *arg)
+{
+	struct bench_peer *peer = arg;
+
+	while (!peer->finished) {
+		if (OBEX_HandleInput(peer->handle, 1) < 0)
+			break;
+	}
+	peer->finished = 1;
+	return NULL;
+}
+
+/*
+ * Client
+ */
+static void client_fill_stream(obex_t *handle, obex_object_t *object,
+			       struct bench_peer *peer)
+{
+	obex_headerdata_t hv;
+	size_t len = peer->size - peer->sent;
+	unsigned int flags = OBEX_FL_STREAM_DATA;
+
+	if (len > BENCH_STREAM_CHUNK)
+		len = BENCH_STREAM_CHUNK;
+	if (peer->sent + len == peer->size)
+		flags = OBEX_FL_STREAM_DATAEND;
+
+	hv.bs = peer->data + peer->sent;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_BODY, hv,
+			     (uint32_t)len, flags);
+	peer->sent += len;
+}
+
+static void client_event(obex_t *handle, obex_object_t *object, int mode,
+			 int event, int obex_cmd, int obex_rsp)
+{
+	struct bench_peer *peer = OBEX_GetUserData(handle);
+
+	switch (event) {
+	case OBEX_EV_PROGRESS:
+		if (obex_cmd == OBEX_CMD_PUT)
+			peer->packets++;
+		break;
+
+	case OBEX_EV_STREAMEMPTY:
+		client_fill_stream(handle, object, peer);
+		break;
+
+	case OBEX_EV_REQDONE:
+		peer->done = 1;
+		peer->rsp = obex_rsp;
+		break;
+
+	case OBEX_EV_LINKERR:
+	case OBEX_EV_PARSEERR:
+	case OBEX_EV_ABORT:
+		peer->done = 1;
+		peer->rsp = -1;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/* Wait for the client handle and let it work. In single response mode,
+ * the client must not block on input while it may send. */
+static int client_wait(struct bench_peer *peer)
+{
+	obex_t *handle = peer->handle;
+	struct pollfd pfd;
+	int64_t deadline;
+	int timeout = 1000;
+	short events;
+	int fd;
+	int ret;
+
+	if (OBEX_GetWaitEvents(handle, &fd, &events, &deadline) < 0)
+		return -1;
+
+	if (deadline != -1) {
+		int64_t left = deadline - (int64_t)(now_seconds() * 1000);
+
+		timeout = left > 0? (int)left: 0;
+	}
+
+	if (fd == -1) {
+		if (deadline != -1)
+			return OBEX_ProcessEvents(handle, 0);
+		return OBEX_HandleInput(handle, 1);
+	}
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	ret = poll(&pfd, 1, timeout);
+	if (ret < 0)
+		return (errno == EINTR)? 0: -1;
+
+	return OBEX_ProcessEvents(handle, pfd.revents);
+}
+
+/* Run one request and wait for its end */
+static int client_request(struct bench_peer *peer, obex_object_t *object)
+{
+	double deadline = now_seconds() + BENCH_TIMEOUT;
+
+	peer->done = 0;
+	peer->rsp = 0;
+	if (OBEX_Request(peer->handle, object) < 0)
+		return -1;
+
+	while (!peer->done) {
+		if (client_wait(peer) < 0)
+			return -1;
+		if (now_seconds() > deadline)
+			return -1;
+	}
+
+	return (peer->rsp == OBEX_RSP_SUCCESS)? 0: -1;
+}
+
+static int client_put(struct bench_peer *peer)
+{
+	obex_t *handle = peer->handle;
+	obex_object_t *object;
+	obex_headerdata_t hv;
+
+	object = OBEX_ObjectNew(handle, OBEX_CMD_PUT);
+	if (object == NULL)
+		return -1;
+
+	hv.bq4 = (uint32_t)peer->size;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_LENGTH, hv, 4, 0);
+
+	peer->sent = 0;
+	if (peer->stream) {
+		hv.bs = NULL;
+		OBEX_ObjectAddHeader(handle, object, OBEX_HDR_BODY, hv, 0,
+				     OBEX_FL_STREAM_START);
+	} else {
+		hv.bs = peer->data;
+		OBEX_ObjectAddHeader(handle, object, OBEX_HDR_BODY, hv,
+				     (uint32_t)peer->size, 0);
+	}
+
+	return client_request(peer, object);
+}
+
+static int client_simple(struct bench_peer *peer, uint8_t cmd)
+{
+	obex_object_t *object = OBEX_ObjectNew(peer->handle, cmd);
+
+	if (object == NULL)
+		return -1;
+	return client_request(peer, object);
+}
+
+/*
+ * Setup of the handles
+ */
+static int connect_peers(const struct bench_config *cfg,
+			 struct bench_peer *client, struct bench_peer *server)
+{
+	int transport = OBEX_TRANS_FD;
+	int sv[2] = { -1, -1 };
+	obex_ctrans_t ctrans;
+
+	switch (cfg->transport) {
+	case BENCH_TCP:
+		transport = OBEX_TRANS_INET;
+		break;
+	case BENCH_FD:
+		transport = OBEX_TRANS_FD;
+		break;
+	case BENCH_CUSTOM:
+		transport = OBEX_TRANS_CUSTOM;
+		break;
+	case BENCH_LOOP:
+		transport = OBEX_TRANS_LOOPBACK;
+		break;
+	}
+
+	client->handle = OBEX_Init(transport, client_event, 0);
+	server->handle = OBEX_Init(transport, server_event, 0);
+	if (client->handle == NULL || server->handle == NULL)
+		return -1;
+
+	OBEX_SetUserData(client->handle, client);
+	OBEX_SetUserData(server->handle, server);
+	OBEX_SetTransportMTU(client->handle, cfg->mtu, cfg->mtu);
+	OBEX_SetTransportMTU(server->handle, cfg->mtu, cfg->mtu);
+	if (cfg->srm)
+		OBEX_SetReponseMode(client->handle, OBEX_RSP_MODE_SINGLE);
+	OBEX_SetLatency(client->handle, 1);
+	OBEX_SetBodySpill(server->handle, cfg->spill);
+
+	if (cfg->transport == BENCH_FD || cfg->transport == BENCH_CUSTOM) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+			return -1;
+		client->fd = sv[0];
+		server->fd = sv[1];
+	}
+
+	switch (cfg->transport) {
+	case BENCH_TCP: {
+		struct sockaddr_in addr;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(tcp_port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (TcpOBEX_ServerRegister(server->handle,
+					   (struct sockaddr *)&addr,
+					   sizeof(addr)) < 0)
+			return -1;
+		if (TcpOBEX_TransportConnect(client->handle,
+					     (struct sockaddr *)&addr,
+					     sizeof(addr)) < 0)
+			return -1;
+		break;
+	}
+
+	case BENCH_FD:
+		if (FdOBEX_TransportSetup(client->handle, sv[0], sv[0], 0) < 0 ||
+		    FdOBEX_TransportSetup(server->handle, sv[1], sv[1], 0) < 0)
+			return -1;
+		break;
+
+	case BENCH_CUSTOM:
+		memset(&ctrans, 0, sizeof(ctrans));
+		ctrans.connect = ctrans_connect;
+		ctrans.disconnect = ctrans_disconnect;
+		ctrans.write = ctrans_write;
+		ctrans.handleinput = ctrans_handleinput;
+
+		ctrans.customdata = client;
+		if (OBEX_RegisterCTransport(client->handle, &ctrans) < 0 ||
+		    OBEX_TransportConnect(client->handle, NULL, 0) < 0)
+			return -1;
+		ctrans.customdata = server;
+		if (OBEX_RegisterCTransport(server->handle, &ctrans) < 0 ||
+		    OBEX_TransportConnect(server->handle, NULL, 0) < 0)
+			return -1;
+		break;
+
+	case BENCH_LOOP:
+		if (LoopOBEX_TransportConnect(client->handle,
+					      server->handle) < 0)
+			return -1;
+		break;
+	}
+
+	return 0;
+}
+
+static void close_peer(struct bench_peer *peer)
+{
+	if (peer->handle)
+		OBEX_Cleanup(peer->handle);
+	if (peer->fd != -1)
+		close(peer->fd);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, unsigned int n, double p)
+{
+	unsigned int i = (unsigned int)(p * (n - 1) + 0.5);
+
+	return sorted[i];
+}
+
+static int run_config(const struct bench_config *cfg, const uint8_t *data,
+		      struct bench_result *res)
+{
+	struct bench_peer *client = calloc(1, sizeof(*client));
+	struct bench_peer *server = calloc(1, sizeof(*server));
+	double *latency = calloc(cfg->requests, sizeof(*latency));
+	pthread_t thread;
+	int thread_started = 0;
+	double start, cpu_start;
+	obex_latency_t *lat;
+	unsigned int i;
+	int err = -1;
+
+	memset(res, 0, sizeof(*res));
+	if (client == NULL || server == NULL || latency == NULL)
+		goto out;
+
+	client->fd = server->fd = -1;
+	client->srm = server->srm = cfg->srm;
+	client->stream = server->stream = cfg->stream;
+	client->data = data;
+	client->size = cfg->size;
+
+	if (connect_peers(cfg, client, server) < 0)
+		goto out;
+
+	if (pthread_create(&thread, NULL, server_thread, server) != 0)
+		goto out;
+	thread_started = 1;
+
+	if (client_simple(client, OBEX_CMD_CONNECT) < 0)
+		goto out;
+
+	OBEX_ResetStats(client->handle);
+	start = now_seconds();
+	cpu_start = cpu_seconds();
+	for (i = 0; i < cfg->requests; ++i) {
+		double t = now_seconds();
+
+		if (client_put(client) < 0)
+			goto out;
+		latency[i] = (now_seconds() - t) * 1e6;
+	}
+	res->seconds = now_seconds() - start;
+	res->cpu_seconds = cpu_seconds() - cpu_start;
+	res->bytes = (unsigned long long)cfg->size * cfg->requests;
+	res->packets = client->packets;
+	OBEX_GetStats(client->handle, &res->stats);
+	lat = OBEX_LatencyNew();
+	if (lat && OBEX_GetLatency(client->handle, lat) == 0) {
+		for (i = 0; i < OBEX_LATENCY_PHASES; ++i)
+			OBEX_LatencyGetSummary(lat, OBEX_CMD_PUT, i,
+					       &res->put[i]);
+	}
+	OBEX_LatencyDelete(lat);
+
+	qsort(latency, cfg->requests, sizeof(*latency), compare_double);
+	res->p50_us = percentile(latency, cfg->requests, 0.50);
+	res->p99_us = percentile(latency, cfg->requests, 0.99);
+
+	client_simple(client, OBEX_CMD_DISCONNECT);
+	err = 0;
+
+out:
+	if (thread_started) {
+		if (err)
+			server->finished = 1;
+		pthread_join(thread, NULL);
+	}
+	if (client && server)
+		res->ok = (err == 0 && server->received == res->bytes);
+	if (client)
+		close_peer(client);
+	if (server)
+		close_peer(server);
+	free(client);
+	free(server);
+	free(latency);
+
+	return err;
+}
+
+static void print_result(const struct bench_config *cfg,
+			 const struct bench_result *res, int first)
+{
+	double secs = res->seconds > 0? res->seconds: 1e-9;
+
+	printf("%s    {\"transport\": \"%s\", \"mtu\": %u, \"object_size\": %lu, "
+	       "\"srm\": %s, \"body\": \"%s\", \"requests\": %u, ",
+	       first? "": ",\n", transport_names[cfg->transport], cfg->mtu,
+	       (unsigned long)cfg->size, cfg->srm? "true": "false",
+	       cfg->stream? "stream": "buffered", cfg->requests);
+	if (!res->ok) {
+		printf("\"ok\": false}");
+		return;
+	}
+	printf("\"ok\": true, \"seconds\": %.6f, \"bytes\": %llu, "
+	       "\"mb_per_s\": %.3f, \"packets\": %lu, \"packets_per_s\": %.1f, "
+	       "\"latency_us\": {\"p50\": %.1f, \"p99\": %.1f}, "
+	       "\"cpu_seconds\": %.6f, ",
+	       res->seconds, res->bytes, res->bytes / secs / 1e6,
+	       res->packets, res->packets / secs,
+	       res->p50_us, res->p99_us, res->cpu_seconds);
+	printf("\"client\": {\"packets_out\": %llu, \"writes\": %llu, "
+	       "\"partial_writes\": %llu, \"reads\": %llu, \"timeouts\": %llu, "
+	       "\"allocs\": %llu, \"callback_seconds\": %.6f}",
+	       (unsigned long long)res->stats.packets_out,
+	       (unsigned long long)res->stats.writes,
+	       (unsigned long long)res->stats.partial_writes,
+	       (unsigned long long)res->stats.reads,
+	       (unsigned long long)res->stats.timeouts,
+	       (unsigned long long)res->stats.allocs,
+	       res->stats.callback_ns / 1e9);
+	printf(", \"put_us\": {\"p50\": %.1f, \"p99\": %.1f, "
+	       "\"app_p50\": %.1f, \"transport_p50\": %.1f, "
+	       "\"rtt_p50\": %.1f, \"rtt_p99\": %.1f}}",
+	       res->put[OBEX_LATENCY_REQUEST].p50 / 1e3,
+	       res->put[OBEX_LATENCY_REQUEST].p99 / 1e3,
+	       res->put[OBEX_LATENCY_APP].p50 / 1e3,
+	       res->put[OBEX_LATENCY_TRANSPORT].p50 / 1e3,
+	       res->put[OBEX_LATENCY_RTT].p50 / 1e3,
+	       res->put[OBEX_LATENCY_RTT].p99 / 1e3);
+}
+
+/* Parse a comma separated list of numbers with an optional k or M suffix */
+static unsigned int parse_list(const char *arg, unsigned long *out,
+			       unsigned int max)
+{
+	unsigned int n = 0;
+	char *end;
+
+	while (*arg && n < max) {
+		unsigned long val = strtoul(arg, &end, 0);
+
+		if (*end == 'k' || *end == 'K') {
+			val *= 1024;
+			++end;
+		} else if (*end == 'm' || *end == 'M') {
+			val *= 1024 * 1024;
+			++end;
+		}
+		out[n++] = val;
+		if (*end != ',')
+			break;
+		arg = end + 1;
+	}
+	return n;
+}
+
+static unsigned int parse_transports(const char *arg, int *out)
+{
+	unsigned int n = 0;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(transport_names) / sizeof(*transport_names);
+	     ++i) {
+		if (strstr(arg, transport_names[i]))
+			out[n++] = (int)i;
+	}
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -t list   transports out of tcp,fd,custom,loop (all)\n"
+		"  -m list   MTUs (1024,8192,65535)\n"
+		"  -s list   object sizes, k and M suffixes allowed (1k,64k,1M,16M)\n"
+		"  -n count  requests per run (chosen from the object size)\n"
+		"  -p port   TCP port on 127.0.0.1 (36650)\n"
+		"  -S size   spill received bodies above size to a file (off)\n"
+		"  -q        quick run with a small sweep\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int transports[4] = { BENCH_TCP, BENCH_FD, BENCH_CUSTOM, BENCH_LOOP };
+	unsigned long mtus[16] = { 1024, 8192, 65535 };
+	unsigned long sizes[16] = { 1024, 65536, 1024 * 1024,
+				    16 * 1024 * 1024 };
+	unsigned int n_transports = 4, n_mtus = 3, n_sizes = 4;
+	unsigned int requests = 0;
+	unsigned long spill = 0;
+	unsigned int t, m, s, mode;
+	size_t max_size = 0;
+	uint8_t *data;
+	int first = 1;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:m:s:n:p:S:qh")) != -1) {
+		switch (opt) {
+		case 't':
+			n_transports = parse_transports(optarg, transports);
+			break;
+		case 'm':
+			n_mtus = parse_list(optarg, mtus, 16);
+			break;
+		case 's':
+			n_sizes = parse_list(optarg, sizes, 16);
+			break;
+		case 'n':
+			requests = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			tcp_port = (unsigned short)strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			parse_list(optarg, &spill, 1);
+			break;
+		case 'q':
+			mtus[0] = 65535;
+			n_mtus = 1;
+			sizes[0] = 1024;
+			sizes[1] = 1024 * 1024;
+			n_sizes = 2;
+			requests = BENCH_MIN_REQUESTS;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (n_transports == 0 || n_mtus == 0 || n_sizes == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (s = 0; s < n_sizes; ++s) {
+		if (sizes[s] > max_size)
+			max_size = sizes[s];
+	}
+	data = malloc(max_size ? max_size : 1);
+	if (data == NULL)
+		return 1;
+	for (s = 0; s < max_size; ++s)
+		data[s] = (uint8_t)s;
+
+	printf("{\n  \"benchmark\": \"obex_bench\",\n  \"results\": [\n");
+	for (t = 0; t < n_transports; ++t)
+	for (m = 0; m < n_mtus; ++m)
+	for (s = 0; s < n_sizes; ++s)
+	for (mode = 0; mode < 4; ++mode) {
+		struct bench_config cfg;
+		struct bench_result res;
+
+		cfg.transport = transports[t];
+		cfg.mtu = (unsigned int)mtus[m];
+		cfg.size = sizes[s];
+		cfg.srm = mode & 1;
+		cfg.stream = (mode >> 1) & 1;
+		cfg.requests = requests;
+		cfg.spill = spill;
+		if (cfg.requests == 0) {
+			cfg.requests = BENCH_TARGET_BYTES / (cfg.size + 1);
+			if (cfg.requests < BENCH_MIN_REQUESTS)
+				cfg.requests = BENCH_MIN_REQUESTS;
+			if (cfg.requests > BENCH_MAX_REQUESTS)
+				cfg.requests = BENCH_MAX_REQUESTS;
+		}
+
+		if (run_config(&cfg, data, &res) < 0 || !res.ok)
+			failed = 1;
+		print_result(&cfg, &res, first);
+		first = 0;
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	free(data);
+	return failed;
+}
@@ -0,0 +1,593 @@
+/**
+	\file apps/obex_bench/obex_hdr_bench.c
+	Microbenchmark for header encoding and parsing.
+	OpenOBEX test applications and sample code.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as
+	published by the Free Software Foundation; either version 2 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#define _GNU_SOURCE
+
+#include "obex_object.h"
+#include "obex_hdr.h"
+#include "obex_pool.h"
+#include "databuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+/* The per-packet functions of the library are driven without a handle
+ * or a transport. A header mix is encoded into packets of the given MTU
+ * like obex_msg_prepare() does, and the packets are parsed again like
+ * obex_msg_receive() does. Each operation is repeated until it ran for
+ * long enough, and the time and the allocations per header are printed
+ * as JSON. */
+
+#define BENCH_MAX_HEADERS	64
+#define BENCH_MAX_PACKETS	256
+#define BENCH_BODY_SIZE		60000
+#define BENCH_MIN_TIME		0.2	/* seconds per operation */
+
+struct bench_header {
+	enum obex_hdr_id id;
+	enum obex_hdr_type type;
+	const void *data;
+	size_t size;
+};
+
+struct bench_mix {
+	const char *name;
+	struct bench_header hdrs[BENCH_MAX_HEADERS];
+	unsigned int count;
+
+	/* encoded form, the header part of each packet */
+	uint8_t *wire;
+	size_t offset[BENCH_MAX_PACKETS + 1];
+	unsigned int packets;
+	unsigned int wire_headers;
+};
+
+struct bench_result {
+	unsigned long long iterations;
+	double seconds;
+	unsigned long long mallocs;
+	unsigned long long pool_allocs;
+	int ok;
+};
+
+typedef int (*bench_op)(struct bench_mix *mix, struct obex_pool *pool,
+			size_t mtu);
+
+#ifdef BENCH_COUNT_ALLOCS
+/* The library is linked statically with its allocator calls wrapped, so
+ * every allocation it does is counted here. */
+static unsigned long long malloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	++malloc_count;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	++malloc_count;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	++malloc_count;
+	return __real_realloc(ptr, size);
+}
+#endif
+
+static unsigned long long get_malloc_count(void)
+{
+#ifdef BENCH_COUNT_ALLOCS
+	return malloc_count;
+#else
+	return 0;
+#endif
+}
+
+static unsigned long long get_pool_allocs(struct obex_pool *pool)
+{
+	struct obex_pool_stats stats;
+
+	obex_pool_get_stats(pool, &stats);
+	return stats.allocs;
+}
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Header mixes
+ */
+
+static uint32_t u32_values[BENCH_MAX_HEADERS];
+static uint8_t u8_values[BENCH_MAX_HEADERS];
+static uint8_t target_uuid[16] = {
+	0xF9, 0xEC, 0x7B, 0xC4, 0x95, 0x3C, 0x11, 0xD2,
+	0x98, 0x4E, 0x52, 0x54, 0x00, 0xDC, 0x9E, 0x09
+};
+static const char type_text[] = "x-obex/folder-listing";
+static const char time_text[] = "20261016T120000Z";
+static uint8_t names[8][80];
+static uint8_t apparams[8][60];
+static uint8_t *body;
+
+static void mix_add(struct bench_mix *mix, enum obex_hdr_id id,
+		    enum obex_hdr_type type, const void *data, size_t size)
+{
+	struct bench_header *h = &mix->hdrs[mix->count++];
+
+	h->id = id;
+	h->type = type;
+	h->data = data;
+	h->size = size;
+}
+
+/* Encode a string as a NUL terminated UTF-16BE name */
+static size_t make_name(uint8_t *out, size_t max, unsigned int n)
+{
+	char name[40];
+	size_t i, len;
+
+	snprintf(name, sizeof(name), "Document %02u - Quarterly report.odt",
+		 n);
+	len = strlen(name) + 1;
+	for (i = 0; i < len && (i + 1) * 2 <= max; ++i) {
+		out[2 * i] = 0;
+		out[2 * i + 1] = (uint8_t)name[i];
+	}
+	return i * 2;
+}
+
+/* Build application parameters out of tag-length-value triplets */
+static size_t make_apparam(uint8_t *out, size_t max, unsigned int n)
+{
+	size_t len = 0;
+	uint8_t tag;
+
+	for (tag = 1; len + 6 <= max && tag <= 10; ++tag) {
+		out[len++] = tag;
+		out[len++] = 4;
+		out[len++] = 0;
+		out[len++] = 0;
+		out[len++] = (uint8_t)n;
+		out[len++] = tag;
+	}
+	return len;
+}
+
+static void init_mixes(struct bench_mix *mixes)
+{
+	unsigned int i;
+	struct bench_mix *mix;
+
+	for (i = 0; i < BENCH_MAX_HEADERS; ++i) {
+		u32_values[i] = htonl(i * 1000);
+		u8_values[i] = (uint8_t)i;
+	}
+
+	mix = &mixes[0];
+	mix->name = "small";
+	for (i = 0; i < 4; ++i) {
+		mix_add(mix, OBEX_HDR_ID_CONNECTION, OBEX_HDR_TYPE_UINT32,
+			&u32_values[i], 4);
+		mix_add(mix, OBEX_HDR_ID_COUNT, OBEX_HDR_TYPE_UINT32,
+			&u32_values[i + 1], 4);
+		mix_add(mix, OBEX_HDR_ID_LENGTH, OBEX_HDR_TYPE_UINT32,
+			&u32_values[i + 2], 4);
+		mix_add(mix, OBEX_HDR_ID_SRM, OBEX_HDR_TYPE_UINT8,
+			&u8_values[1], 1);
+		mix_add(mix, OBEX_HDR_ID_SRM_FLAGS, OBEX_HDR_TYPE_UINT8,
+			&u8_values[i], 1);
+		mix_add(mix, OBEX_HDR_ID_TARGET, OBEX_HDR_TYPE_BYTES,
+			target_uuid, sizeof(target_uuid));
+		mix_add(mix, OBEX_HDR_ID_TYPE, OBEX_HDR_TYPE_BYTES,
+			type_text, sizeof(type_text));
+		mix_add(mix, OBEX_HDR_ID_TIME, OBEX_HDR_TYPE_BYTES,
+			time_text, sizeof(time_text) - 1);
+	}
+
+	mix = &mixes[1];
+	mix->name = "body";
+	mix_add(mix, OBEX_HDR_ID_CONNECTION, OBEX_HDR_TYPE_UINT32,
+		&u32_values[1], 4);
+	mix_add(mix, OBEX_HDR_ID_LENGTH, OBEX_HDR_TYPE_UINT32,
+		&u32_values[2], 4);
+	mix_add(mix, OBEX_HDR_ID_BODY, OBEX_HDR_TYPE_BYTES,
+		body, BENCH_BODY_SIZE);
+	mix_add(mix, OBEX_HDR_ID_BODY_END, OBEX_HDR_TYPE_BYTES, NULL, 0);
+
+	mix = &mixes[2];
+	mix->name = "unicode";
+	for (i = 0; i < 8; ++i)
+		mix_add(mix, OBEX_HDR_ID_NAME, OBEX_HDR_TYPE_UNICODE, names[i],
+			make_name(names[i], sizeof(names[i]), i));
+
+	mix = &mixes[3];
+	mix->name = "appparam";
+	mix_add(mix, OBEX_HDR_ID_CONNECTION, OBEX_HDR_TYPE_UINT32,
+		&u32_values[1], 4);
+	for (i = 0; i < 8; ++i)
+		mix_add(mix, OBEX_HDR_ID_APPARAM, OBEX_HDR_TYPE_BYTES,
+			apparams[i],
+			make_apparam(apparams[i], sizeof(apparams[i]), i));
+}
+
+/*
+ * Operations
+ */
+
+/* Queue the headers of the mix on a new object like OBEX_ObjectAddHeader()
+ * and split them into packets like obex_msg_prepare(). With a wire
+ * buffer, the encoded packets are kept there. */
+static int encode_mix(struct bench_mix *mix, struct obex_pool *pool,
+		      size_t mtu, uint8_t *wire)
+{
+	obex_object_t *object = obex_object_new(pool);
+	buf_t *txmsg = iovbuf_create(mtu);
+	unsigned int i;
+	size_t len = 0;
+	int err = -1;
+
+	if (object == NULL || txmsg == NULL)
+		goto out;
+
+	for (i = 0; i < mix->count; ++i) {
+		const struct bench_header *h = &mix->hdrs[i];
+		struct obex_hdr *hdr = obex_hdr_create(pool, h->id, h->type,
+						       h->data, h->size,
+						       OBEX_FL_COPY);
+
+		if (hdr == NULL)
+			goto out;
+		if (!obex_object_queue_tx(object, hdr)) {
+			obex_hdr_destroy(hdr);
+			goto out;
+		}
+	}
+
+	if (wire)
+		mix->packets = 0;
+	while (obex_hdr_it_get(object->tx_it) != NULL) {
+		size_t plen;
+
+		buf_clear(txmsg, buf_get_length(txmsg));
+		obex_object_append_data(object, txmsg, mtu - 3);
+		plen = buf_get_length(txmsg);
+		if (plen == 0)
+			goto out;
+
+		if (wire) {
+			if (mix->packets == BENCH_MAX_PACKETS)
+				goto out;
+			memcpy(wire + len, buf_get(txmsg), plen);
+			mix->offset[mix->packets++] = len;
+		}
+		len += plen;
+	}
+	if (wire)
+		mix->offset[mix->packets] = len;
+	err = 0;
+
+out:
+	if (txmsg)
+		buf_delete(txmsg);
+	if (object)
+		obex_object_delete(object);
+	return err;
+}
+
+static int op_encode(struct bench_mix *mix, struct obex_pool *pool,
+		     size_t mtu)
+{
+	return encode_mix(mix, pool, mtu, NULL);
+}
+
+/* Parse all headers of all packets without keeping them */
+static int op_parse(struct bench_mix *mix, struct obex_pool *pool,
+		    size_t mtu)
+{
+	unsigned int p;
+	unsigned int n = 0;
+
+	for (p = 0; p < mix->packets; ++p) {
+		size_t offset = mix->offset[p];
+
+		while (offset < mix->offset[p + 1]) {
+			struct obex_hdr *hdr;
+
+			hdr = obex_hdr_ptr_parse(pool, mix->wire + offset,
+						 mix->offset[p + 1] - offset);
+			if (hdr == NULL)
+				return -1;
+			offset += obex_hdr_get_size(hdr);
+			obex_hdr_destroy(hdr);
+			++n;
+		}
+	}
+
+	return (n == mix->wire_headers)? 0: -1;
+}
+
+/* Receive all packets into a new object like obex_msg_receive() */
+static int receive_mix(struct bench_mix *mix, struct obex_pool *pool,
+		       struct obex_hdr_viewbuf *view)
+{
+	obex_object_t *object = obex_object_new(pool);
+	unsigned int p;
+	int err = 0;
+
+	if (object == NULL)
+		return -1;
+
+	for (p = 0; p < mix->packets && err == 0; ++p) {
+		size_t len = mix->offset[p + 1] - mix->offset[p];
+
+		if (obex_object_receive_headers(object,
+						mix->wire + mix->offset[p],
+						len, 0, view) < 0)
+			err = -1;
+	}
+
+	obex_object_delete(object);
+	return err;
+}
+
+static int op_receive(struct bench_mix *mix, struct obex_pool *pool,
+		      size_t mtu)
+{
+	return receive_mix(mix, pool, NULL);
+}
+
+/* Like op_receive but with OBEX_FL_RX_NOCOPY */
+static int op_receive_view(struct bench_mix *mix, struct obex_pool *pool,
+			   size_t mtu)
+{
+	struct obex_hdr_viewbuf *view;
+	int err;
+
+	view = obex_hdr_viewbuf_new(pool, mix->wire);
+	if (view == NULL)
+		return -1;
+	err = receive_mix(mix, pool, view);
+	obex_hdr_viewbuf_unref(view);
+	return err;
+}
+
+static const struct {
+	const char *name;
+	bench_op run;
+} ops[] = {
+	{ "encode", op_encode },
+	{ "parse", op_parse },
+	{ "receive", op_receive },
+	{ "receive_view", op_receive_view },
+};
+
+/* Run an operation often enough to take at least min_time seconds */
+static void run_op(bench_op run, struct bench_mix *mix, size_t mtu,
+		   double min_time, struct bench_result *res)
+{
+	unsigned long long n = 1;
+
+	memset(res, 0, sizeof(*res));
+	for (;;) {
+		struct obex_pool *pool = obex_pool_create();
+		unsigned long long mallocs, pool_allocs, i;
+		double start;
+
+		if (pool == NULL)
+			return;
+
+		/* Warm up the pool so that its slabs are not counted */
+		if (run(mix, pool, mtu) < 0) {
+			obex_pool_destroy(pool);
+			return;
+		}
+
+		mallocs = get_malloc_count();
+		pool_allocs = get_pool_allocs(pool);
+		start = now_seconds();
+		for (i = 0; i < n; ++i) {
+			if (run(mix, pool, mtu) < 0)
+				break;
+		}
+		res->seconds = now_seconds() - start;
+		res->mallocs = get_malloc_count() - mallocs;
+		res->pool_allocs = get_pool_allocs(pool) - pool_allocs;
+		res->iterations = n;
+		res->ok = (i == n);
+		obex_pool_destroy(pool);
+
+		if (!res->ok || res->seconds >= min_time)
+			return;
+		if (res->seconds > min_time / 100)
+			n = (unsigned long long)(n * min_time * 1.2 /
+						 res->seconds) + 1;
+		else
+			n *= 100;
+	}
+}
+
+static void print_result(const char *op, const struct bench_mix *mix,
+			 size_t mtu, unsigned int headers,
+			 const struct bench_result *res, int first)
+{
+	double count = (double)res->iterations * headers;
+
+	if (count == 0)
+		count = 1;
+
+	printf("%s    {\"op\": \"%s\", \"mix\": \"%s\", \"mtu\": %lu, "
+	       "\"headers\": %u, \"packets\": %u, \"wire_bytes\": %lu, ",
+	       first? "": ",\n", op, mix->name, (unsigned long)mtu, headers,
+	       mix->packets, (unsigned long)mix->offset[mix->packets]);
+	if (!res->ok) {
+		printf("\"ok\": false}");
+		return;
+	}
+	printf("\"ok\": true, \"iterations\": %llu, \"ns_per_header\": %.1f, "
+	       "\"mallocs_per_header\": ",
+	       res->iterations, res->seconds * 1e9 / count);
+#ifdef BENCH_COUNT_ALLOCS
+	printf("%.3f", res->mallocs / count);
+#else
+	printf("null");
+#endif
+	printf(", \"pool_allocs_per_header\": %.3f}", res->pool_allocs / count);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -m mtu    packet size (65535)\n"
+		"  -T secs   minimum run time of each operation (0.2)\n"
+		"  -x mix    only run one of small,body,unicode,appparam\n"
+		"  -o op     only run one of encode,parse,receive,receive_view\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_mix mixes[4];
+	const unsigned int n_mixes = sizeof(mixes) / sizeof(*mixes);
+	const char *only_mix = NULL;
+	const char *only_op = NULL;
+	double min_time = BENCH_MIN_TIME;
+	size_t mtu = OBEX_MAXIMUM_MTU;
+	unsigned int m, o;
+	int first = 1;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:T:x:o:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mtu = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			min_time = strtod(optarg, NULL);
+			break;
+		case 'x':
+			only_mix = optarg;
+			break;
+		case 'o':
+			only_op = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (mtu < OBEX_MINIMUM_MTU || mtu > OBEX_MAXIMUM_MTU) {
+		fprintf(stderr, "MTU must be between %d and %d\n",
+			OBEX_MINIMUM_MTU, OBEX_MAXIMUM_MTU);
+		return 1;
+	}
+
+	body = malloc(BENCH_BODY_SIZE);
+	if (body == NULL)
+		return 1;
+	for (m = 0; m < BENCH_BODY_SIZE; ++m)
+		body[m] = (uint8_t)m;
+
+	memset(mixes, 0, sizeof(mixes));
+	init_mixes(mixes);
+
+	/* Encode every mix once to have something to parse */
+	for (m = 0; m < n_mixes; ++m) {
+		struct bench_mix *mix = &mixes[m];
+		struct obex_pool *pool = obex_pool_create();
+		struct obex_hdr *hdr;
+		size_t offset;
+		size_t size = 3 * BENCH_MAX_PACKETS;
+		unsigned int i;
+
+		/* Split headers get another 3 byte prefix in every packet */
+		for (i = 0; i < mix->count; ++i)
+			size += mix->hdrs[i].size + 3;
+		mix->wire = malloc(size);
+		if (pool == NULL || mix->wire == NULL ||
+		    encode_mix(mix, pool, mtu, mix->wire) < 0) {
+			fprintf(stderr, "Cannot encode mix %s\n", mix->name);
+			return 1;
+		}
+
+		offset = 0;
+		while (offset < mix->offset[mix->packets]) {
+			hdr = obex_hdr_ptr_parse(pool, mix->wire + offset,
+					mix->offset[mix->packets] - offset);
+			if (hdr == NULL)
+				break;
+			offset += obex_hdr_get_size(hdr);
+			obex_hdr_destroy(hdr);
+			++mix->wire_headers;
+		}
+		obex_pool_destroy(pool);
+	}
+
+	printf("{\n  \"benchmark\": \"obex_hdr_bench\",\n  \"results\": [\n");
+	for (m = 0; m < n_mixes; ++m)
+	for (o = 0; o < sizeof(ops) / sizeof(*ops); ++o) {
+		struct bench_mix *mix = &mixes[m];
+		struct bench_result res;
+		unsigned int headers;
+
+		if (only_mix && strcmp(only_mix, mix->name) != 0)
+			continue;
+		if (only_op && strcmp(only_op, ops[o].name) != 0)
+			continue;
+
+		/* Encoding works on the headers that the application added,
+		 * parsing on the headers that went over the wire. */
+		headers = (ops[o].run == op_encode)? mix->count:
+						     mix->wire_headers;
+		run_op(ops[o].run, mix, mtu, min_time, &res);
+		if (!res.ok)
+			failed = 1;
+		print_result(ops[o].name, mix, mtu, headers, &res, first);
+		first = 0;
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	for (m = 0; m < n_mixes; ++m)
+		free(mixes[m].wire);
+	free(body);
+	return failed;
+}
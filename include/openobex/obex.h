@@ -56,9 +56,13 @@ extern "C" {
 
 struct obex;
 struct obex_object;
+struct obex_reactor;
+struct obex_runtime;
 
 typedef struct obex obex_t;
 typedef struct obex_object obex_object_t;
+typedef struct obex_reactor obex_reactor_t;
+typedef struct obex_runtime obex_runtime_t;
 
 typedef void (*obex_event_t)(obex_t *handle, obex_object_t *obj, int mode, int event, int obex_cmd, int obex_rsp);
 
@@ -73,6 +77,7 @@ OPENOBEX_SYMBOL(void)     OBEX_SetUserData(obex_t *self, void * data);
 OPENOBEX_SYMBOL(void *)   OBEX_GetUserData(obex_t *self);
 OPENOBEX_SYMBOL(void)     OBEX_SetUserCallBack(obex_t *self, obex_event_t eventcb, void * data);
 OPENOBEX_SYMBOL(int)      OBEX_SetTransportMTU(obex_t *self, uint16_t mtu_rx, uint16_t mtu_tx_max);
+OPENOBEX_SYMBOL(int)      OBEX_SetReadAhead(obex_t *self, unsigned int size);
 OPENOBEX_SYMBOL(int)      OBEX_GetFD(obex_t *self);
 
 OPENOBEX_SYMBOL(int)    OBEX_RegisterCTransport(obex_t *self, obex_ctrans_t *ctrans);
@@ -82,12 +87,34 @@ OPENOBEX_SYMBOL(void *) OBEX_GetCustomData(obex_t *self);
 OPENOBEX_SYMBOL(int) OBEX_TransportConnect(obex_t *self, struct sockaddr *saddr, int addlen);
 OPENOBEX_SYMBOL(int) OBEX_TransportDisconnect(obex_t *self);
 OPENOBEX_SYMBOL(int) OBEX_CustomDataFeed(obex_t *self, uint8_t *inputbuf, int actual);
+OPENOBEX_SYMBOL(int) OBEX_CustomDataFeedMulti(obex_t *self, const uint8_t *inputbuf, size_t len, size_t *consumed);
 
 OPENOBEX_SYMBOL(void)                     OBEX_SetTimeout(obex_t *self, int64_t timeout);
 OPENOBEX_SYMBOL(int)                      OBEX_Work(obex_t *self);
 OPENOBEX_SYMBOL(enum obex_data_direction) OBEX_GetDataDirection(obex_t *self);
 OPENOBEX_SYMBOL(int)                      OBEX_HandleInput(obex_t *self, int timeout);
-
+OPENOBEX_SYMBOL(int)                      OBEX_GetWaitEvents(obex_t *self, int *fd, short *events, int64_t *deadline);
+OPENOBEX_SYMBOL(int)                      OBEX_ProcessEvents(obex_t *self, short revents);
+
+OPENOBEX_SYMBOL(int)  OBEX_GetStats(obex_t *self, obex_stats_t *stats);
+OPENOBEX_SYMBOL(void) OBEX_ResetStats(obex_t *self);
+OPENOBEX_SYMBOL(int)  OBEX_SetTrace(obex_t *self, unsigned int size, unsigned int flags);
+OPENOBEX_SYMBOL(int)  OBEX_GetTrace(obex_t *self, obex_trace_t *entries, unsigned int max);
+OPENOBEX_SYMBOL(void) OBEX_DumpTrace(obex_t *self);
+OPENOBEX_SYMBOL(int)  OBEX_SetLatency(obex_t *self, int enable);
+OPENOBEX_SYMBOL(int)  OBEX_GetLatency(obex_t *self, obex_latency_t *lat);
+OPENOBEX_SYMBOL(obex_latency_t *) OBEX_LatencyNew(void);
+OPENOBEX_SYMBOL(void) OBEX_LatencyDelete(obex_latency_t *lat);
+OPENOBEX_SYMBOL(void) OBEX_LatencyReset(obex_latency_t *lat);
+OPENOBEX_SYMBOL(void) OBEX_LatencyMerge(obex_latency_t *dst, const obex_latency_t *src);
+OPENOBEX_SYMBOL(uint64_t) OBEX_LatencyPercentile(const obex_latency_t *lat, uint8_t cmd,
+						enum obex_latency_phase phase, double p);
+OPENOBEX_SYMBOL(int)  OBEX_LatencyGetSummary(const obex_latency_t *lat, uint8_t cmd,
+						enum obex_latency_phase phase,
+						obex_latency_summary_t *summary);
+
+OPENOBEX_SYMBOL(int)      OBEX_SetListenBacklog(obex_t *self, int backlog);
+OPENOBEX_SYMBOL(int)      OBEX_SetAcceptBatch(obex_t *self, unsigned int count);
 OPENOBEX_SYMBOL(int)      OBEX_ServerRegister(obex_t *self, struct sockaddr *saddr, int addrlen);
 OPENOBEX_SYMBOL(obex_t *) OBEX_ServerAccept(obex_t *server, obex_event_t eventcb, void * data);
 
@@ -102,12 +129,19 @@ OPENOBEX_SYMBOL(int)             OBEX_ObjectGetSpace(obex_t *self, obex_object_t
 
 OPENOBEX_SYMBOL(void) OBEX_SetReponseMode(obex_t *self,
 					  enum obex_rsp_mode rsp_mode);
+OPENOBEX_SYMBOL(int) OBEX_SetSrmBatchSize(obex_t *self, unsigned int size);
+OPENOBEX_SYMBOL(int) OBEX_SetBodySpill(obex_t *self, size_t threshold);
 
 OPENOBEX_SYMBOL(int) OBEX_ObjectAddHeader(obex_t *self, obex_object_t *object,
 				    uint8_t hi, obex_headerdata_t hv, uint32_t hv_size,
 				    unsigned int flags);
+OPENOBEX_SYMBOL(int) OBEX_ObjectAddBodyFd(obex_t *self, obex_object_t *object,
+				    int fd, uint64_t offset, uint64_t length,
+				    unsigned int flags);
 OPENOBEX_SYMBOL(int) OBEX_ObjectGetNextHeader(obex_t *self, obex_object_t *object,
 					uint8_t *hi, obex_headerdata_t *hv, uint32_t *hv_size);
+OPENOBEX_SYMBOL(int) OBEX_ObjectFindHeader(obex_t *self, obex_object_t *object,
+					uint8_t hi, obex_headerdata_t *hv, uint32_t *hv_size);
 OPENOBEX_SYMBOL(int) OBEX_ObjectReParseHeaders(obex_t *self, obex_object_t *object);
 OPENOBEX_SYMBOL(int) OBEX_ObjectSetRsp(obex_object_t *object, uint8_t rsp, uint8_t lastrsp);
 
@@ -124,6 +158,7 @@ OPENOBEX_SYMBOL(char *) OBEX_ResponseToString(int rsp);
  */
 OPENOBEX_SYMBOL(int) TcpOBEX_ServerRegister(obex_t *self, struct sockaddr *addr, int addrlen);
 OPENOBEX_SYMBOL(int) TcpOBEX_TransportConnect(obex_t *self, struct sockaddr *addr, int addrlen);
+OPENOBEX_SYMBOL(int) TcpOBEX_SetSendPolicy(obex_t *self, unsigned int policy);
 
 /*
  * IrOBEX API 
@@ -155,6 +190,24 @@ OPENOBEX_SYMBOL(int) BtOBEX_ServerRegister(obex_t *self, const bt_addr_t *src, u
 OPENOBEX_SYMBOL(int) BtOBEX_TransportConnect(obex_t *self, const bt_addr_t *src, const bt_addr_t *dst, uint8_t channel);
 #endif
 
+/*
+ * UnixOBEX API (Unix domain sockets)
+ */
+OPENOBEX_SYMBOL(int) UnixOBEX_ServerRegister(obex_t *self, const char *path, int type);
+OPENOBEX_SYMBOL(int) UnixOBEX_TransportConnect(obex_t *self, const char *path, int type);
+OPENOBEX_SYMBOL(int) UnixOBEX_PassFd(obex_t *self, int fd);
+OPENOBEX_SYMBOL(int) UnixOBEX_GetPassedFd(obex_t *self);
+
+/*
+ * LoopOBEX API (in-process pairs)
+ */
+OPENOBEX_SYMBOL(int) LoopOBEX_TransportConnect(obex_t *self, obex_t *peer);
+
+/*
+ * UsbOBEX API
+ */
+OPENOBEX_SYMBOL(int) UsbOBEX_SetTransfers(obex_t *self, unsigned int rx, unsigned int tx);
+
 /*
  * OBEX File API
  */
@@ -168,6 +221,23 @@ OPENOBEX_SYMBOL(obex_interface_t *)  OBEX_GetInterfaceByIndex(obex_t *self, int
 OPENOBEX_SYMBOL(int)  OBEX_InterfaceConnect(obex_t *self, obex_interface_t *intf);
 OPENOBEX_SYMBOL(void) OBEX_FreeInterfaces(obex_t *self);
 
+/*
+ * OBEX reactor API
+ */
+OPENOBEX_SYMBOL(obex_reactor_t *) OBEX_ReactorNew(void);
+OPENOBEX_SYMBOL(void) OBEX_ReactorDelete(obex_reactor_t *reactor);
+OPENOBEX_SYMBOL(int)  OBEX_ReactorAdd(obex_reactor_t *reactor, obex_t *self);
+OPENOBEX_SYMBOL(int)  OBEX_ReactorRemove(obex_reactor_t *reactor, obex_t *self);
+OPENOBEX_SYMBOL(int)  OBEX_ReactorRun(obex_reactor_t *reactor, int64_t timeout);
+
+/*
+ * OBEX server runtime API
+ */
+OPENOBEX_SYMBOL(obex_runtime_t *) OBEX_RuntimeNew(unsigned int workers);
+OPENOBEX_SYMBOL(void) OBEX_RuntimeDelete(obex_runtime_t *rt);
+OPENOBEX_SYMBOL(int)  OBEX_RuntimeAdd(obex_runtime_t *rt, obex_t *self);
+OPENOBEX_SYMBOL(int)  OBEX_RuntimeClose(obex_runtime_t *rt, obex_t *self);
+
 #ifdef __cplusplus
 }
 #endif
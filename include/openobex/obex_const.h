@@ -145,6 +145,105 @@ typedef union {
 	obex_usb_intf_t usb;
 } obex_interface_t;
 
+/** Performance counters of a handle, see #OBEX_GetStats() */
+typedef struct {
+	/** Bytes received from the transport or fed by the application */
+	uint64_t bytes_in;
+	/** Bytes handed to the transport */
+	uint64_t bytes_out;
+	/** Complete packets received */
+	uint64_t packets_in;
+	/** Packets prepared for sending */
+	uint64_t packets_out;
+	/** Read calls to the transport */
+	uint64_t reads;
+	/** Write calls to the transport */
+	uint64_t writes;
+	/** Write calls that did not take all data */
+	uint64_t partial_writes;
+	/** Waits for input that ended without input */
+	uint64_t timeouts;
+	/** Packets received in single response mode */
+	uint64_t srm_packets_in;
+	/** Packets prepared in single response mode */
+	uint64_t srm_packets_out;
+	/** #OBEX_EV_STREAMEMPTY events */
+	uint64_t stream_empty;
+	/** #OBEX_EV_STREAMAVAIL events */
+	uint64_t stream_avail;
+	/** Allocations through the handle's pool: objects, headers, their
+	 *  helpers and received data kept for header views, including those
+	 *  too large for the pool that come from malloc() */
+	uint64_t allocs;
+	/** Calls of the event callback */
+	uint64_t callbacks;
+	/** Time spent in the event callback, in nanoseconds */
+	uint64_t callback_ns;
+} obex_stats_t;
+
+/** Kinds of trace entries, see #OBEX_GetTrace() */
+enum obex_trace_type {
+	/** State machine step: code is the state, value the substate */
+	OBEX_TRACE_STATE = 0,
+	/** Packet prepared: code is the opcode, value the length */
+	OBEX_TRACE_TX = 1,
+	/** Packet received: code is the opcode, value the length */
+	OBEX_TRACE_RX = 2,
+	/** Transport write: value is the result */
+	OBEX_TRACE_WRITE = 3,
+	/** Transport read: code is the requested size, value the result */
+	OBEX_TRACE_READ = 4,
+	/** Wait for input: value is 1 for input, 0 for timeout, -1 for error */
+	OBEX_TRACE_WAIT = 5,
+	/** Event for the application: code is the event, value holds
+	 *  the command in bits 8-15 and the response in bits 0-7 */
+	OBEX_TRACE_EVENT = 6,
+};
+
+/** One entry of the trace of a handle */
+typedef struct {
+	/** Monotonic time in nanoseconds */
+	int64_t time;
+	/** One of #obex_trace_type */
+	uint16_t type;
+	/** Type specific code */
+	uint16_t code;
+	/** Type specific value */
+	int32_t value;
+} obex_trace_t;
+
+/** Latency histograms of the requests of a handle,
+ *  see #OBEX_GetLatency() */
+typedef struct obex_latency obex_latency_t;
+
+/** Phases of a request that have their own latency histogram */
+enum obex_latency_phase {
+	/** First request packet to final response */
+	OBEX_LATENCY_REQUEST = 0,
+	/** Time spent in the event callback during the request */
+	OBEX_LATENCY_APP = 1,
+	/** Time spent in transport reads and writes during the request */
+	OBEX_LATENCY_TRANSPORT = 2,
+	/** Packet sent to next packet received, only without SRM */
+	OBEX_LATENCY_RTT = 3,
+};
+#define OBEX_LATENCY_PHASES 4
+
+/** Summary of one latency histogram, all times in nanoseconds */
+typedef struct {
+	/** Number of recorded values */
+	uint64_t count;
+	/** Sum of all recorded values */
+	uint64_t sum;
+	/** Largest recorded value */
+	uint64_t max;
+	/** Percentiles, accurate to 1/8 of their value */
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+} obex_latency_summary_t;
+
 /** Possible modes */
 enum obex_mode {
 	OBEX_MODE_CLIENT = 0, /**< client mode */
@@ -196,6 +295,16 @@ enum obex_event {
 #define OBEX_FL_FILTERIAS       (1 <<  3) /**< Filter devices based on IAS entry */
 #define OBEX_FL_CLOEXEC         (1 <<  4) /**< Set CLOEXEC flag on file descriptors */
 #define OBEX_FL_NONBLOCK        (1 <<  5) /**< Set the NONBLOCK flag on file descriptors */ 
+#define OBEX_FL_RX_NOCOPY       (1 <<  6) /**< Keep received headers in the receive buffer */
+#define OBEX_FL_REUSEPORT       (1 <<  7) /**< Allow several servers to listen on the same port */
+
+/* For TcpOBEX_SetSendPolicy() */
+#define OBEX_TCP_NODELAY        (1 <<  0) /**< Disable the Nagle algorithm */
+#define OBEX_TCP_MORE           (1 <<  1) /**< Hold back partial segments while more packets follow */
+#define OBEX_TCP_DEFAULT        (OBEX_TCP_NODELAY | OBEX_TCP_MORE)
+
+/* For OBEX_SetTrace() */
+#define OBEX_TRACE_DUMP_LINKERR (1 <<  0) /**< Dump the trace to the debug log on a link error */
 
 /* For OBEX_ObjectAddHeader */
 #define OBEX_FL_FIT_ONE_PACKET  (1 <<  0) /**< This header must fit in one packet */
@@ -213,6 +322,8 @@ enum obex_transport_type {
 	OBEX_TRANS_BLUETOOTH = 4, /**< Bluetooth RFCOMM */
 	OBEX_TRANS_FD = 5,        /**< file descriptors */
 	OBEX_TRANS_USB = 6,       /**< USB CDC OBEX */
+	OBEX_TRANS_UNIX = 7,      /**< Unix domain sockets */
+	OBEX_TRANS_LOOPBACK = 8,  /**< In-process link between two handles */
 };
 
 /* Standard headers */
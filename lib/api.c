@@ -47,6 +47,8 @@
 #include "obex_body.h"
 #include "obex_msg.h"
 #include "obex_connect.h"
+#include "obex_reactor.h"
+#include "obex_runtime.h"
 #include "databuffer.h"
 
 #ifdef HAVE_IRDA
@@ -58,9 +60,13 @@
 #ifdef HAVE_USB
 #include "transport/usbobex.h"
 #endif /*HAVE_USB*/
+#ifdef HAVE_UNIX_SOCKET
+#include "transport/unixobex.h"
+#endif /*HAVE_UNIX_SOCKET*/
 #include "transport/inobex.h"
 #include "transport/customtrans.h"
 #include "transport/fdobex.h"
+#include "transport/loopobex.h"
 
 #include "obex_incl.h"
 
@@ -73,6 +79,9 @@
 			register your own transport with #OBEX_RegisterCTransport()
 			- #OBEX_TRANS_BLUETOOTH: Use regular Bluetooth RFCOMM socket
 			- #OBEX_TRANS_USB: Use USB transport (libusb needed)
+			- #OBEX_TRANS_UNIX: Use a Unix domain socket
+			- #OBEX_TRANS_LOOPBACK: Use an in-process link to another
+			handle, see LoopOBEX_TransportConnect()
 	\param eventcb Function pointer to your event callback.
 			See obex.h for prototype of this callback.
 	\param flags Bitmask of flags. The following flags are available :
@@ -81,6 +90,7 @@
 			- #OBEX_FL_FILTERIAS  : Filter target devices based on IAS entry
 			- #OBEX_FL_CLOEXEC    : Open all sockets with SO_CLOEXEC set
 			- #OBEX_FL_NONBLOCK   : Open all sockets non-blocking
+			- #OBEX_FL_RX_NOCOPY  : Do not copy received headers
 	\return an OBEX handle or NULL on error.
  */
 LIB_SYMBOL
@@ -207,6 +217,72 @@ int CALLAPI OBEX_SetTransportMTU(obex_t *self, uint16_t mtu_rx,
 	return obex_set_mtu(self, mtu_rx, mtu_tx_max);
 }
 
+/**
+	Set the amount of data to read from the transport at once.
+	\param self OBEX handle
+	\param size maximum number of bytes per read, 0 to disable read-ahead
+	\return -1 or negative error code on error
+
+	By default, each received packet is read in two steps: first the packet
+	header, then the rest of the packet. With read-ahead enabled, a single
+	read fetches everything that is available up to \a size bytes, so a
+	packet usually costs only one read and following packets that already
+	arrived are processed without reading from the transport again.
+
+	Only use this with transports that do not rely on the received data
+	being consumed packet by packet.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetReadAhead(obex_t *self, unsigned int size)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+
+	self->rx_readahead = size;
+	return 0;
+}
+
+/**
+	Set the length of the queue of pending connections.
+	\param self OBEX handle
+	\param backlog maximum number of pending connections, 0 for the system
+		maximum
+	\return -1 or negative error code on error
+
+	This must be called before the server is registered. The default
+	is 1.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetListenBacklog(obex_t *self, int backlog)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+	obex_return_val_if_fail(backlog >= 0, -EINVAL);
+
+	obex_transport_set_backlog(self, backlog);
+	return 0;
+}
+
+/**
+	Set how many connections may be accepted per wakeup.
+	\param self OBEX handle
+	\param count maximum number of #OBEX_EV_ACCEPTHINT events per call
+	\return -1 or negative error code on error
+
+	When a server handle that was created with #OBEX_FL_KEEPSERVER becomes
+	readable, the application gets an #OBEX_EV_ACCEPTHINT event. As long as
+	it calls #OBEX_ServerAccept() and more connections are waiting, the event
+	is repeated up to \a count times. This empties the queue of pending
+	connections quickly when many clients connect at once. The default is 1.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetAcceptBatch(obex_t *self, unsigned int count)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+	obex_return_val_if_fail(count > 0, -EINVAL);
+
+	self->accept_batch = count;
+	return 0;
+}
+
 /**
 	Start listening for incoming connections.
 	\param self OBEX handle
@@ -251,6 +327,10 @@ int CALLAPI OBEX_ServerRegister(obex_t *self, struct sockaddr *saddr, int addrle
 
 	Using this function also requires that the OBEX handle was created
 	with the #OBEX_FL_KEEPSERVER flag set while calling #OBEX_Init().
+
+	To spread connections over several threads, create one server handle
+	with #OBEX_FL_REUSEPORT per thread and register all of them on the same
+	address. The system then distributes new connections between them.
  */
 LIB_SYMBOL
 obex_t *CALLAPI OBEX_ServerAccept(obex_t *server, obex_event_t eventcb,
@@ -288,6 +368,10 @@ obex_t *CALLAPI OBEX_ServerAccept(obex_t *server, obex_event_t eventcb,
 	self->mode = OBEX_MODE_SERVER;
         self->state = STATE_IDLE;
 	self->rsp_mode = server->rsp_mode;
+	self->rx_readahead = server->rx_readahead;
+	self->srm_batch = server->srm_batch;
+	self->tx_record = server->tx_record;
+	server->accept_count++;
 
 	return self;
 
@@ -345,6 +429,292 @@ enum obex_data_direction CALLAPI OBEX_GetDataDirection(obex_t *self)
 	return obex_get_data_direction(self);
 }
 
+/**
+	Report what a handle waits for.
+	\param self OBEX handle
+	\param fd Returns the descriptor to watch, or -1 if there is none
+	\param events Returns the poll events (POLLIN, POLLOUT) to watch for
+	\param deadline Returns the time in milliseconds at which
+		#OBEX_ProcessEvents() must be called even if no event occurred,
+		or -1 if there is no such time
+	\return -1 on error, 0 on success
+
+	Use this to embed many handles into an external event loop. Call it
+	after each call of #OBEX_ProcessEvents() and update the loop
+	accordingly.
+
+	The deadline is an absolute time of a clock that never jumps
+	(CLOCK_MONOTONIC on POSIX systems, GetTickCount64() on Windows). It is
+	mostly used to ask for an immediate call when data is already buffered.
+	The timeout set with #OBEX_SetTimeout() does not result in a deadline.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_GetWaitEvents(obex_t *self, int *fd, short *events,
+			       int64_t *deadline)
+{
+	obex_return_val_if_fail(self != NULL, -1);
+	obex_return_val_if_fail(fd != NULL, -1);
+	obex_return_val_if_fail(events != NULL, -1);
+	obex_return_val_if_fail(deadline != NULL, -1);
+
+	DEBUG(4, "\n");
+	obex_get_wait_events(self, fd, events, deadline);
+	return 0;
+}
+
+/**
+	Let the OBEX parser do some work without blocking.
+	\param self OBEX handle
+	\param revents Poll events that occurred on the descriptor of the handle
+		(0 if the deadline was reached)
+	\return -1 on error, 0 if nothing could be done, positive on success
+
+	The events must be the ones that the event loop saw for the descriptor
+	reported by #OBEX_GetWaitEvents(). They are trusted, so the descriptor is
+	not polled again. Unlike #OBEX_Work(), this function never waits,
+	but blocking sockets may still block while sending data.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ProcessEvents(obex_t *self, short revents)
+{
+	obex_return_val_if_fail(self != NULL, -1);
+
+	DEBUG(4, "\n");
+	return obex_process_events(self, revents);
+}
+
+/**
+	Get the performance counters of a handle.
+	\param self OBEX handle
+	\param stats structure to fill in
+	\return -1 or negative error code on error
+
+	The counters are kept since the handle was created or since the last
+	call to #OBEX_ResetStats(). They are updated by the thread that runs
+	the handle, so read them from there to get a consistent snapshot.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_GetStats(obex_t *self, obex_stats_t *stats)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+	obex_return_val_if_fail(stats != NULL, -EINVAL);
+
+	obex_get_stats(self, stats);
+	return 0;
+}
+
+/**
+	Set the performance counters of a handle to zero.
+	\param self OBEX handle
+
+	This also clears the latency histograms of the handle.
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_ResetStats(obex_t *self)
+{
+	obex_return_if_fail(self != NULL);
+
+	obex_reset_stats(self);
+}
+
+/**
+	Start or stop tracing the events of a handle.
+	\param self OBEX handle
+	\param size number of entries to keep, 0 to stop tracing
+	\param flags #OBEX_TRACE_DUMP_LINKERR or 0
+	\return -1 or negative error code on error
+
+	The trace keeps the newest \a size entries (rounded up to a power of
+	two) about state machine steps, packets, transport calls and events in
+	a ring buffer. Entries are only numbers and a time stamp, so tracing
+	is cheap enough to leave on. Earlier entries are dropped when the
+	trace is resized.
+
+	Setting the OBEX_TRACE environment variable to a size traces all new
+	handles and dumps the trace on link errors.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetTrace(obex_t *self, unsigned int size, unsigned int flags)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+
+	if (obex_set_trace(self, size, flags) < 0)
+		return -ENOMEM;
+	return 0;
+}
+
+/**
+	Get the newest entries of the trace of a handle.
+	\param self OBEX handle
+	\param entries array to fill in, oldest entry first
+	\param max number of elements of \a entries
+	\return the number of entries, -1 or negative error code on error
+
+	This may be called from any thread. Entries that are overwritten while
+	they are copied are left out.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_GetTrace(obex_t *self, obex_trace_t *entries,
+			  unsigned int max)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+	obex_return_val_if_fail(entries != NULL || max == 0, -EINVAL);
+
+	if (self->trace == NULL)
+		return 0;
+	return (int)obex_trace_get(self->trace, entries, max);
+}
+
+/**
+	Write the trace of a handle to the debug log.
+	\param self OBEX handle
+
+	Every line shows the time relative to the newest entry, the kind of
+	entry, its code and its value, see #obex_trace_type.
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_DumpTrace(obex_t *self)
+{
+	obex_return_if_fail(self != NULL);
+
+	if (self->trace)
+		obex_trace_dump(self->trace, "trace");
+}
+
+/**
+	Start or stop recording latency histograms for a handle.
+	\param self OBEX handle
+	\param enable 1 to start recording, 0 to stop and drop all values
+	\return -1 or negative error code on error
+
+	Every finished request adds to one histogram per phase of its
+	command, see #obex_latency_phase. A request starts with its first
+	packet and ends with the final response or an abort. Requests that
+	fail with a parse or link error are not recorded.
+
+	OBEX_ResetStats() also clears the histograms.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetLatency(obex_t *self, int enable)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+
+	if (obex_set_latency(self, enable != 0) < 0)
+		return -ENOMEM;
+	return 0;
+}
+
+/**
+	Add the latency histograms of a handle to a set of histograms.
+	\param self OBEX handle
+	\param lat histograms from OBEX_LatencyNew()
+	\return -1 or negative error code on error
+
+	Call this for every handle of a server to get the histograms of all
+	its connections. This must be called from the thread that runs the
+	handle.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_GetLatency(obex_t *self, obex_latency_t *lat)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+	obex_return_val_if_fail(lat != NULL, -EINVAL);
+
+	if (self->latency == NULL)
+		return -EINVAL;
+
+	obex_latency_merge(lat, self->latency);
+	return 0;
+}
+
+/**
+	Create an empty set of latency histograms.
+	\return the histograms or NULL on error
+ */
+LIB_SYMBOL
+obex_latency_t * CALLAPI OBEX_LatencyNew(void)
+{
+	return obex_latency_create();
+}
+
+/**
+	Free a set of latency histograms.
+	\param lat histograms from OBEX_LatencyNew()
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_LatencyDelete(obex_latency_t *lat)
+{
+	obex_latency_destroy(lat);
+}
+
+/**
+	Remove all values from a set of latency histograms.
+	\param lat histograms from OBEX_LatencyNew()
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_LatencyReset(obex_latency_t *lat)
+{
+	obex_return_if_fail(lat != NULL);
+
+	obex_latency_reset(lat);
+}
+
+/**
+	Add all values of one set of latency histograms to another.
+	\param dst histograms to add to
+	\param src histograms to add
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_LatencyMerge(obex_latency_t *dst, const obex_latency_t *src)
+{
+	obex_return_if_fail(dst != NULL);
+	obex_return_if_fail(src != NULL);
+
+	obex_latency_merge(dst, src);
+}
+
+/**
+	Get a percentile of a latency histogram.
+	\param lat histograms
+	\param cmd command (OBEX_CMD_*), all commands above #OBEX_CMD_SESSION
+	       share one histogram
+	\param phase one of #obex_latency_phase
+	\param p percentile between 0 and 100
+	\return time in nanoseconds, 0 if nothing was recorded
+ */
+LIB_SYMBOL
+uint64_t CALLAPI OBEX_LatencyPercentile(const obex_latency_t *lat, uint8_t cmd,
+					enum obex_latency_phase phase,
+					double p)
+{
+	obex_return_val_if_fail(lat != NULL, 0);
+
+	return obex_latency_percentile(lat, cmd, phase, p);
+}
+
+/**
+	Get the count, sum, maximum and common percentiles of a latency
+	histogram.
+	\param lat histograms
+	\param cmd command (OBEX_CMD_*)
+	\param phase one of #obex_latency_phase
+	\param summary structure to fill in
+	\return -1 or negative error code on error
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_LatencyGetSummary(const obex_latency_t *lat, uint8_t cmd,
+				   enum obex_latency_phase phase,
+				   obex_latency_summary_t *summary)
+{
+	obex_return_val_if_fail(lat != NULL, -EINVAL);
+	obex_return_val_if_fail(summary != NULL, -EINVAL);
+	obex_return_val_if_fail((unsigned int)phase < OBEX_LATENCY_PHASES,
+				-EINVAL);
+
+	obex_latency_summary(lat, cmd, phase, summary);
+	return 0;
+}
+
 /**
 	Let the OBEX parser do some work.
 	\param self OBEX handle
@@ -411,12 +781,46 @@ int CALLAPI OBEX_CustomDataFeed(obex_t *self, uint8_t *inputbuf, int actual)
 
 	obex_return_val_if_fail(self != NULL, -1);
 
-	if (inputbuf && actual > 0)
+	if (inputbuf && actual > 0) {
 		buf_append(self->rx_msg, inputbuf, (size_t)actual);
+		self->stats.bytes_in += actual;
+	}
 
 	return obex_data_indication(self);
 }
 
+/**
+	Feed OBEX with a buffer that holds any number of packets when using a
+	custom transport.
+	\param self OBEX handle
+	\param inputbuf Pointer to custom data
+	\param len Length of buffer
+	\param consumed Set to the number of bytes taken from the buffer
+	\return number of processed packets, -1 on error
+
+	Every complete packet is processed right away, including writing the
+	reply, so there is no need to call OBEX_HandleInput() for it. Bytes of
+	a trailing partial packet are kept until the next call. When the handle
+	cannot continue without waiting, e.g. because the transport did not
+	take a reply, less than \a len bytes are consumed and the rest must be
+	fed again later.
+
+	When called from the handleinput callback of the custom transport, the
+	data is only buffered like with OBEX_CustomDataFeed().
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_CustomDataFeedMulti(obex_t *self, const uint8_t *inputbuf,
+				     size_t len, size_t *consumed)
+{
+	DEBUG(3, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+	obex_return_val_if_fail(inputbuf != NULL || len == 0, -1);
+	obex_return_val_if_fail(consumed != NULL, -1);
+
+	return obex_data_feed(self, inputbuf, len, consumed);
+}
+
 /**
 	Try to connect to peer.
 	\param self OBEX handle
@@ -503,10 +907,12 @@ int CALLAPI OBEX_Request(obex_t *self, obex_object_t *object)
 	}
 
 	object->rsp_mode = self->rsp_mode;
+	object->body_spill = self->body_spill;
 	self->object = object;
 	self->mode = OBEX_MODE_CLIENT;
         self->state = STATE_REQUEST;
 	self->substate = SUBSTATE_TX_PREPARE;
+	obex_latency_request_start(self, object->cmd);
 
 	/* Prepare the packet but do not send it */
 	result = obex_client(self);
@@ -559,6 +965,57 @@ int CALLAPI OBEX_ResumeRequest(obex_t *self)
 	return obex_object_resume(self->object);
 }
 
+/**
+	Send several packets at once in single response mode.
+	\param self OBEX handle
+	\param size maximum number of bytes to send at once, 0 to disable
+	\return -1 or negative error code on error
+
+	In single response mode, the sender does not wait for the peer between
+	packets. With a batch size of at least the TX MTU, as many packets as
+	fit into \a size bytes are prepared and handed to the transport
+	together. This saves system calls and keeps the link busy, but
+	the peer's input is only looked at between batches and there is only
+	one #OBEX_EV_PROGRESS event per batch.
+
+	Only use this with transports that do not rely on each write carrying
+	exactly one packet.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetSrmBatchSize(obex_t *self, unsigned int size)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+
+	self->srm_batch = size;
+	return 0;
+}
+
+/**
+	Keep large received bodies in a temporary file instead of memory.
+	\param self OBEX handle
+	\param threshold largest body in bytes that is kept on the heap,
+	       0 to always keep bodies on the heap
+	\return -1 or negative error code on error
+
+	This only applies to bodies that are not read as a stream. A body
+	that grows beyond \a threshold, or that is announced to be larger by
+	a Length header, is moved to an unlinked file in $TMPDIR (or /tmp)
+	that is mapped into memory. OBEX_ObjectGetNextHeader() still returns
+	a pointer to the whole body, but the system can write its pages to
+	disk and drop them, so many large objects received at the same time
+	do not all have to fit into memory.
+
+	Has no effect on systems without mmap().
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_SetBodySpill(obex_t *self, size_t threshold)
+{
+	obex_return_val_if_fail(self != NULL, -EFAULT);
+
+	self->body_spill = threshold;
+	return 0;
+}
+
 /**
 	Set the OBEX response mode.
 	\param self OBEX context
@@ -598,7 +1055,7 @@ obex_object_t * CALLAPI OBEX_ObjectNew(obex_t *self, uint8_t cmd)
 
 	obex_return_val_if_fail(self != NULL, NULL);
 
-	object = obex_object_new();
+	object = obex_object_new(self->pool);
 	if (object == NULL)
 		return NULL;
 
@@ -692,6 +1149,37 @@ int CALLAPI OBEX_ObjectAddHeader(obex_t *self, obex_object_t *object, uint8_t hi
 	return obex_object_addheader(self, object, hi, hv, hv_size, flags);
 }
 
+/**
+	Attach a body to an object that is read from a file.
+	\param self OBEX handle
+	\param object OBEX object
+	\param fd Descriptor of a regular file
+	\param offset Position of the body data in the file
+	\param length Number of bytes to send
+	\param flags #OBEX_FL_SUSPEND or 0
+	\return -1 on error
+
+	The data is sent as BODY headers and a final BODY_END header without
+	being copied to an application buffer first. Where possible, the TCP
+	and file descriptor transports pass it from the file to the connection
+	with sendfile().
+
+	The file descriptor is not closed by the library and must stay open and
+	unmodified until the request finished. The position of the descriptor
+	is not changed.
+
+	This cannot be combined with a body stream on the same object.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ObjectAddBodyFd(obex_t *self, obex_object_t *object, int fd,
+				 uint64_t offset, uint64_t length,
+				 unsigned int flags)
+{
+	obex_return_val_if_fail(self != NULL, -1);
+	obex_return_val_if_fail(object != NULL, -1);
+	return obex_object_add_body_fd(self, object, fd, offset, length, flags);
+}
+
 /**
 	Get next available header from an object.
 	\param self OBEX handle (ignored)
@@ -716,6 +1204,32 @@ int CALLAPI OBEX_ObjectGetNextHeader(obex_t *self, obex_object_t *object, uint8_
 	return obex_object_getnextheader(object, hi, hv, hv_size);
 }
 
+/**
+	Find a received header by its identifier.
+	\param self OBEX handle (ignored)
+	\param object OBEX object
+	\param hi Header identifier to look for
+	\param hv Pointer to hv
+	\param hv_size Pointer to hv_size
+	\return 1 if the header was found, 0 if not, -1 on error
+
+	If the header was received more than once, the first one is
+	returned. The lookup does not use the header iterator of
+	#OBEX_ObjectGetNextHeader().
+
+	All headers are read-only.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ObjectFindHeader(obex_t *self, obex_object_t *object,
+				  uint8_t hi, obex_headerdata_t *hv,
+				  uint32_t *hv_size)
+{
+	obex_return_val_if_fail(object != NULL, -1);
+	obex_return_val_if_fail(hv != NULL, -1);
+	obex_return_val_if_fail(hv_size != NULL, -1);
+	return obex_object_findheader(object, hi, hv, hv_size);
+}
+
 /**
 	Allow the user to parse again the rx headers.
 	\param self OBEX handle (ignored)
@@ -994,6 +1508,33 @@ int CALLAPI TcpOBEX_TransportConnect(obex_t *self, struct sockaddr *addr,
 	return obex_transport_connect_request(self)? 1: -1;
 }
 
+/**
+	Change how OBEX packets are handed to TCP.
+	\param self OBEX handle
+	\param policy combination of OBEX_TCP_* flags
+	\return -1 on error
+
+	With #OBEX_TCP_NODELAY, small packets (e.g. a CONNECT or a short
+	response) are sent without waiting for outstanding acknowledgements.
+	With #OBEX_TCP_MORE, the packets of a single response mode transfer are
+	marked as incomplete (MSG_MORE, if supported) while more of them
+	follow, so that full segments are sent. The last packet is always sent
+	right away. The default is #OBEX_TCP_DEFAULT.
+
+	Accepted connections inherit the policy of the server. This may be
+	called at any time.
+ */
+LIB_SYMBOL
+int CALLAPI TcpOBEX_SetSendPolicy(obex_t *self, unsigned int policy)
+{
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+
+	inobex_set_send_policy(self, policy);
+	return 0;
+}
+
 /**
 	Start listening for incoming connections.
 	\param self OBEX handle
@@ -1105,6 +1646,157 @@ int CALLAPI BtOBEX_TransportConnect(obex_t *self, const bt_addr_t *src,
 #endif /* HAVE_BLUETOOTH */
 }
 
+/**
+	Start listening on a Unix domain socket.
+	\param self OBEX handle
+	\param path filesystem path of the socket, or a name starting with '@'
+	       for the Linux abstract namespace
+	\param type SOCK_STREAM or SOCK_SEQPACKET, 0 for SOCK_STREAM
+	\return -1 or negative error code on error
+
+	An easier server function to use for Unix domain sockets only.
+	A stale socket file at \a path is not removed, this is left to the
+	application.
+
+	With SOCK_SEQPACKET, every OBEX packet is one record and the read size
+	(see OBEX_SetReadAhead()) is raised to the maximum MTU so that a record
+	is never truncated. SRM batches (see OBEX_SetSrmBatchSize()) are limited
+	to the same size.
+ */
+LIB_SYMBOL
+int CALLAPI UnixOBEX_ServerRegister(obex_t *self, const char *path, int type)
+{
+	DEBUG(3, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+	obex_return_val_if_fail(path != NULL, -1);
+
+#ifdef HAVE_UNIX_SOCKET
+	if (!unixobex_prepare_listen(self, path, type))
+		return -1;
+	return obex_transport_listen(self)? 1: -1;
+#else
+	return -ESOCKTNOSUPPORT;
+#endif /* HAVE_UNIX_SOCKET */
+}
+
+/**
+	Connect Unix domain socket transport.
+	\param self OBEX handle
+	\param path filesystem path of the socket, or a name starting with '@'
+	       for the Linux abstract namespace
+	\param type SOCK_STREAM or SOCK_SEQPACKET, 0 for SOCK_STREAM
+	\return -1 or negative error code on error
+
+	An easier connect function to use for Unix domain sockets only.
+ */
+LIB_SYMBOL
+int CALLAPI UnixOBEX_TransportConnect(obex_t *self, const char *path, int type)
+{
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+
+	if (self->object) {
+		DEBUG(1, "We are busy.\n");
+		return -EBUSY;
+	}
+
+	obex_return_val_if_fail(path != NULL, -1);
+
+#ifdef HAVE_UNIX_SOCKET
+	if (!unixobex_prepare_connect(self, path, type))
+		return -1;
+	return obex_transport_connect_request(self)? 1: -1;
+#else
+	return -ESOCKTNOSUPPORT;
+#endif /* HAVE_UNIX_SOCKET */
+}
+
+/**
+	Pass a file descriptor to the peer.
+	\param self OBEX handle
+	\param fd descriptor to pass
+	\return 0 on success or negative error code on error
+
+	A copy of \a fd is sent along with the next OBEX packet, the caller
+	keeps ownership of \a fd. Up to 8 descriptors can be queued per packet.
+	This is only available with the #OBEX_TRANS_UNIX transport.
+ */
+LIB_SYMBOL
+int CALLAPI UnixOBEX_PassFd(obex_t *self, int fd)
+{
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+	obex_return_val_if_fail(fd >= 0, -EBADF);
+
+#ifdef HAVE_UNIX_SOCKET
+	return unixobex_pass_fd(self, fd);
+#else
+	return -ESOCKTNOSUPPORT;
+#endif /* HAVE_UNIX_SOCKET */
+}
+
+/**
+	Take a file descriptor that was passed by the peer.
+	\param self OBEX handle
+	\return the oldest received descriptor or negative error code
+	(-ENOENT if there is none)
+
+	Descriptors arrive with the packet they were sent with, so they are
+	available from the #OBEX_EV_REQHINT event (or the matching response
+	event) onwards. The caller owns the returned descriptor. Descriptors
+	that are not taken are closed on disconnect.
+ */
+LIB_SYMBOL
+int CALLAPI UnixOBEX_GetPassedFd(obex_t *self)
+{
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+
+#ifdef HAVE_UNIX_SOCKET
+	return unixobex_get_passed_fd(self);
+#else
+	return -ESOCKTNOSUPPORT;
+#endif /* HAVE_UNIX_SOCKET */
+}
+
+/**
+	Link two handles of the same process with each other.
+	\param self OBEX handle
+	\param peer OBEX handle for the other end
+	\return -1 or negative error code on error
+
+	Both handles must have been created with #OBEX_TRANS_LOOPBACK and are
+	connected afterwards. Packets are handed over through a ring buffer per
+	direction without any system call, as long as neither side has to wait.
+	One side is usually driven as server and the other as client.
+
+	The two handles may be used from different threads. When both are used
+	from the same thread, call OBEX_HandleInput() with a timeout of 0 and
+	alternate between them, a blocking call would wait for itself.
+ */
+LIB_SYMBOL
+int CALLAPI LoopOBEX_TransportConnect(obex_t *self, obex_t *peer)
+{
+	int err;
+
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+	obex_return_val_if_fail(peer != NULL, -1);
+
+	if (self->object || peer->object) {
+		DEBUG(1, "We are busy.\n");
+		return -EBUSY;
+	}
+
+	err = loopobex_pair(self, peer);
+	return (err < 0)? err: 1;
+}
+
 /*
 	FdOBEX_TransportSetup - setup descriptors for OBEX_TRANS_FD transport.
 
@@ -1159,6 +1851,40 @@ int CALLAPI OBEX_InterfaceConnect(obex_t *self, obex_interface_t *intf)
 		return -ESOCKTNOSUPPORT;
 }
 
+/**
+	Keep several USB bulk transfers in flight.
+	\param self OBEX handle
+	\param rx number of IN transfers to keep queued
+	\param tx number of OUT transfers that may be in flight
+	\return -1 or negative error code on error
+
+	By default, each packet is sent and received with a synchronous
+	transfer and the bus idles while a packet is processed. With
+	asynchronous transfers, \a rx IN transfers are always queued so that
+	the device can go on sending, and a write returns as soon as the data
+	is queued unless \a tx transfers are still in flight. Errors of
+	queued writes are reported by a later write or read. Use 0 for both to
+	get synchronous transfers again.
+
+	The transfers are driven by the libusb event handling of this handle,
+	so the descriptor from OBEX_GetFD() still works with poll().
+	This must be called before OBEX_InterfaceConnect() and needs libusb 1.x.
+ */
+LIB_SYMBOL
+int CALLAPI UsbOBEX_SetTransfers(obex_t *self, unsigned int rx,
+				 unsigned int tx)
+{
+	DEBUG(4, "\n");
+
+	obex_return_val_if_fail(self != NULL, -1);
+
+#ifdef HAVE_USB1
+	return usbobex_set_transfers(self, rx, tx);
+#else
+	return -ESOCKTNOSUPPORT;
+#endif /* HAVE_USB1 */
+}
+
 /**
 	Find OBEX interfaces on the system.
 	\param self OBEX handle
@@ -1209,3 +1935,183 @@ void CALLAPI OBEX_FreeInterfaces(obex_t *self)
 
 	obex_transport_free_interfaces(self);
 }
+
+/**
+	Create a reactor.
+	\return a new reactor or NULL on error
+
+	A reactor waits for many OBEX handles at once (using epoll where
+	available) and lets only those handles do work that are ready.
+	This replaces a wait on each handle with #OBEX_HandleInput().
+ */
+LIB_SYMBOL
+obex_reactor_t * CALLAPI OBEX_ReactorNew(void)
+{
+	DEBUG(4, "\n");
+
+	return obex_reactor_create();
+}
+
+/**
+	Delete a reactor.
+	\param reactor reactor to delete
+
+	All handles still registered are removed from the reactor but not
+	deleted.
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_ReactorDelete(obex_reactor_t *reactor)
+{
+	obex_return_if_fail(reactor != NULL);
+
+	obex_reactor_destroy(reactor);
+}
+
+/**
+	Register an OBEX handle with a reactor.
+	\param reactor the reactor
+	\param self OBEX handle
+	\return 0 on success or a negative error code on failure (-EINVAL,
+	-EBUSY, -ENOMEM)
+
+	The handle must have a file descriptor (see #OBEX_GetFD()), which
+	includes listening server handles. Handles accepted with
+	#OBEX_ServerAccept() while handling #OBEX_EV_ACCEPTHINT can be added
+	right from the event callback.
+
+	If processing of a handle fails, e.g. after #OBEX_EV_LINKERR or on
+	a suspended request, the reactor stops watching it. Calling this
+	function again on such a handle (e.g. after #OBEX_ResumeRequest())
+	re-arms it.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ReactorAdd(obex_reactor_t *reactor, obex_t *self)
+{
+	obex_return_val_if_fail(reactor != NULL, -EINVAL);
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+
+	return obex_reactor_add(reactor, self);
+}
+
+/**
+	Remove an OBEX handle from a reactor.
+	\param reactor the reactor
+	\param self OBEX handle
+	\return 0 on success or -ENOENT if the handle is not registered
+
+	This may be called from within the event callback of any handle.
+	Calling #OBEX_Cleanup() on a registered handle removes it
+	automatically, but must not be done from within an event callback.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ReactorRemove(obex_reactor_t *reactor, obex_t *self)
+{
+	obex_return_val_if_fail(reactor != NULL, -EINVAL);
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+
+	return obex_reactor_remove(reactor, self);
+}
+
+/**
+	Wait for registered handles and let the ready ones do some work.
+	\param reactor the reactor
+	\param timeout Maximum time to wait in milliseconds (-1 for infinite)
+	\return number of ready handles, 0 on timeout or a negative error code
+
+	Each ready handle is processed without blocking, the transport
+	timeout set with #OBEX_SetTimeout() is not used. Call this function
+	in a loop.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_ReactorRun(obex_reactor_t *reactor, int64_t timeout)
+{
+	obex_return_val_if_fail(reactor != NULL, -EINVAL);
+
+	return obex_reactor_run(reactor, timeout);
+}
+
+/**
+	Create a server runtime.
+	\param workers number of worker threads, 0 for one per CPU
+	\return a new runtime or NULL on error
+
+	Each worker thread runs its own reactor. Handles given to the
+	runtime with #OBEX_RuntimeAdd() are spread over the workers, and a
+	worker that has nothing to do takes over handles from the busiest
+	one. A handle is only used by one thread at a time, so the event
+	callback of a handle never runs concurrently with itself. Different
+	handles run in parallel, though.
+ */
+LIB_SYMBOL
+obex_runtime_t * CALLAPI OBEX_RuntimeNew(unsigned int workers)
+{
+	DEBUG(4, "\n");
+
+	return obex_runtime_create(workers);
+}
+
+/**
+	Delete a server runtime.
+	\param rt runtime to delete
+
+	Stops all worker threads and deletes all handles that are still
+	owned by the runtime. This must not be called from an event callback
+	of such a handle.
+ */
+LIB_SYMBOL
+void CALLAPI OBEX_RuntimeDelete(obex_runtime_t *rt)
+{
+	obex_return_if_fail(rt != NULL);
+
+	obex_runtime_destroy(rt);
+}
+
+/**
+	Give an OBEX handle to a server runtime.
+	\param rt the runtime
+	\param self OBEX handle
+	\return 0 on success or a negative error code on failure (-EINVAL,
+	-EBUSY, -ENOMEM)
+
+	The runtime takes ownership of the handle: from now on, it is only
+	used by a worker thread and must be deleted with
+	#OBEX_RuntimeClose() instead of #OBEX_Cleanup(). The handle must have
+	a file descriptor and must not be registered with a reactor.
+
+	A listening server handle (with #OBEX_FL_KEEPSERVER) can be added
+	as well. Handles accepted with #OBEX_ServerAccept() while handling
+	#OBEX_EV_ACCEPTHINT can be added right from the event callback.
+
+	Calling this for a handle that the runtime already owns re-arms it,
+	like #OBEX_ReactorAdd() does.
+
+	This may be called from any thread.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_RuntimeAdd(obex_runtime_t *rt, obex_t *self)
+{
+	obex_return_val_if_fail(rt != NULL, -EINVAL);
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+
+	return obex_runtime_add(rt, self);
+}
+
+/**
+	Remove an OBEX handle from a server runtime and delete it.
+	\param rt the runtime
+	\param self OBEX handle
+	\return 0 on success or -ENOENT if the handle is not owned by the
+	runtime
+
+	The handle is deleted by its worker thread as soon as it is not used
+	anymore, so this may be called from within the event callback of the
+	handle, e.g. on #OBEX_EV_LINKERR. This may be called from any thread.
+ */
+LIB_SYMBOL
+int CALLAPI OBEX_RuntimeClose(obex_runtime_t *rt, obex_t *self)
+{
+	obex_return_val_if_fail(rt != NULL, -EINVAL);
+	obex_return_val_if_fail(self != NULL, -EINVAL);
+
+	return obex_runtime_close(rt, self);
+}
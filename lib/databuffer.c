@@ -22,70 +22,16 @@
 #include "databuffer.h"
 #include "obex_main.h"
 
-#include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 
-int slist_has_more(slist_t *list)
-{
-	return (!slist_is_empty(list) && !slist_is_empty(list->next));
-}
-
-void *slist_get(slist_t *list)
-{
-	if (slist_is_empty(list))
-		return NULL;
-	else
-		return list->data;
-}
-
-slist_t *slist_append(slist_t *list, void *element)
-{
-	slist_t *node, *p;
-
-	node = malloc(sizeof(*node));
-	assert(node != NULL);
-	node->data = element;
-	node->next = NULL;
-	if (!list)
-		return node;
-	p = list;
-	while (p->next)
-		p = p->next;
-	p->next = node;
-	return list;
-}
-
-slist_t *slist_remove(slist_t *list, void *element)
-{
-	slist_t *prev, *next;
-
-	if (!list)
-		return NULL;
-	prev = list;
-	next = list;
-	while (next != NULL) {
-		if (next->data == element) {
-			/* if first element, update list pointer */
-			if (next == list) {
-				list = list->next;
-				prev = list;
-				free(next);
-				next = prev;
-			} else {
-				prev->next = next->next;
-				free(next);
-				next = prev->next;
-			}
-			continue;
-		}
-		prev = next;
-		next = next->next;
-	}
-	return list;
-}
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 struct databuffer *buf_create(size_t default_size, struct databuffer_ops *ops) {
 	struct databuffer *self = malloc(sizeof(*self));
@@ -161,22 +107,128 @@ int buf_append(struct databuffer *self, const void *data, size_t len) {
 		return -EINVAL;
 }
 
+/** Append data that is not copied.
+ * The data must stay valid until it was cleared from the buffer. Buffers
+ * that cannot reference data copy it instead.
+ */
+int buf_append_ref(struct databuffer *self, const void *data, size_t len) {
+	if (self->ops->append_ref)
+		return self->ops->append_ref(self->ops_data, data, len);
+	else
+		return buf_append(self, data, len);
+}
+
+/** Overwrite already appended (and not referenced) data */
+int buf_write(struct databuffer *self, size_t offset, const void *data,
+	      size_t len) {
+	uint8_t *p;
+
+	if (self->ops->write)
+		return self->ops->write(self->ops_data, offset, data, len);
+
+	if (offset + len > buf_get_length(self))
+		return -EINVAL;
+	p = buf_get(self);
+	if (!p)
+		return -EINVAL;
+	memcpy(p + offset, data, len);
+	return 0;
+}
+
+/** Get the buffer content as a list of contiguous parts
+ * @return the number of used entries in vec
+ */
+int buf_get_vec(const struct databuffer *self, struct databuffer_vec *vec,
+		int count) {
+	if (self->ops->get_vec)
+		return self->ops->get_vec(self->ops_data, vec, count);
+
+	if (count < 1 || buf_get_length(self) == 0)
+		return 0;
+	vec[0].base = buf_get(self);
+	vec[0].len = buf_get_length(self);
+	vec[0].fd = -1;
+	vec[0].offset = 0;
+	return 1;
+}
+
+/** Append data that is read from a file when it is sent
+ * The file must stay open until the data was cleared from the buffer.
+ */
+int buf_append_file(struct databuffer *self, int fd, uint64_t offset,
+		    size_t len) {
+	void *tmp;
+	int ret;
+
+	if (self->ops->append_file)
+		return self->ops->append_file(self->ops_data, fd, offset, len);
+
+	tmp = malloc(len ? len : 1);
+	if (!tmp)
+		return -ENOMEM;
+
+	ret = buf_read_file(fd, offset, tmp, len);
+	if (ret == 0)
+		ret = buf_append(self, tmp, len);
+	free(tmp);
+	return ret;
+}
+
+/** Read exactly len bytes at offset from a file without moving the file
+ * position (on systems that have pread())
+ */
+int buf_read_file(int fd, uint64_t offset, void *data, size_t len) {
+	uint8_t *p = data;
+
+	while (len) {
+		ssize_t n;
+
+#ifdef _WIN32
+		if (_lseeki64(fd, offset, SEEK_SET) < 0)
+			return -errno;
+		n = _read(fd, p, (unsigned int)len);
+#else
+		n = pread(fd, p, len, (off_t)offset);
+#endif
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (n == 0)
+			return -EIO;	/* file got truncated */
+
+		p += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
 void buf_dump(buf_t *p, const char *label)
 {
-	unsigned int i, n;
+	static const char hex[] = "0123456789ABCDEF";
+	const uint8_t *data;
+	size_t len, i;
 
 	if (!p || !label)
 		return;
 
-	n = 0;
-	for (i = 0; i < buf_get_length(p); ++i) {
-		if (n == 0)
-			log_debug("%s%s(%04x):", log_debug_prefix, label, i);
-		log_debug(" %02X", *((uint8_t *)buf_get(p) + i));
-		if (n >= 0xF || i == buf_get_length(p) - 1) {
-			log_debug("\n");
-			n = 0;
-		} else
-			n++;
+	/* Format whole lines, the log may be slow per call */
+	data = buf_get(p);
+	len = buf_get_length(p);
+	for (i = 0; i < len; i += 16) {
+		char line[16 * 3 + 1];
+		size_t n;
+
+		for (n = 0; n < 16 && i + n < len; ++n) {
+			line[n * 3] = ' ';
+			line[n * 3 + 1] = hex[data[i + n] >> 4];
+			line[n * 3 + 2] = hex[data[i + n] & 0xF];
+		}
+		line[n * 3] = '\0';
+		log_debug("%s%s(%04x):%s\n", log_debug_prefix, label,
+			  (unsigned int)i, line);
 	}
 }
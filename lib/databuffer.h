@@ -27,14 +27,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-/*
- * Implements a single linked list
- */
-struct databuffer_list {
-        void *data;
-        struct databuffer_list *next;
+/** One contiguous part of a buffer */
+struct databuffer_vec {
+	const void *base;	/* NULL if the data is in a file */
+	size_t len;
+	int fd;			/* file to read from if base is NULL */
+	uint64_t offset;	/* position in that file */
 };
-typedef struct databuffer_list slist_t;
 
 /** This implements an abstracted data buffer. */
 struct databuffer_ops {
@@ -48,6 +47,10 @@ struct databuffer_ops {
 	void *(*get)(const void *self);
 	void (*clear)(void *self, size_t len);
 	int (*append)(void *self, const void *data, size_t len);
+	int (*append_ref)(void *self, const void *data, size_t len);
+	int (*write)(void *self, size_t offset, const void *data, size_t len);
+	int (*get_vec)(const void *self, struct databuffer_vec *vec, int count);
+	int (*append_file)(void *self, int fd, uint64_t offset, size_t len);
 };
 
 struct databuffer {
@@ -57,6 +60,9 @@ struct databuffer {
 typedef struct databuffer buf_t;
 
 #include <membuf.h>
+#include <iovbuf.h>
+#include <ringbuf.h>
+#include <spillbuf.h>
 
 struct databuffer *buf_create(size_t default_size, struct databuffer_ops *ops);
 void buf_delete(struct databuffer *self);
@@ -68,13 +74,15 @@ size_t buf_get_length(const struct databuffer *self);
 void *buf_get(const struct databuffer *self);
 void buf_clear(struct databuffer *self, size_t len);
 int buf_append(struct databuffer *self, const void *data, size_t len);
+int buf_append_ref(struct databuffer *self, const void *data, size_t len);
+int buf_write(struct databuffer *self, size_t offset, const void *data,
+	      size_t len);
+int buf_get_vec(const struct databuffer *self, struct databuffer_vec *vec,
+		int count);
+int buf_append_file(struct databuffer *self, int fd, uint64_t offset,
+		    size_t len);
+int buf_read_file(int fd, uint64_t offset, void *data, size_t len);
 void buf_dump(buf_t *p, const char *label);
 
 
-#define slist_is_empty(l) ((l) == NULL)
-int slist_has_more(slist_t *list);
-void *slist_get(slist_t *list);
-slist_t *slist_append(slist_t *list, void *element);
-slist_t *slist_remove(slist_t *list, void *element);
-
 #endif
@@ -0,0 +1,423 @@
+/**
+	\file iovbuf.c
+	Scatter-gather buffer handling routines.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "iovbuf.h"
+#include "databuffer.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* The buffer content is a list of segments. Copied data is kept in a
+ * staging area, referenced data stays where the caller has it and must
+ * stay valid until it was cleared from the buffer. File data is only
+ * read when a transport cannot send it from the file directly. */
+
+#define IOVBUF_SEGMENTS 8
+
+struct iovbuf_seg {
+	const uint8_t *ref;	/* referenced data, NULL if staged */
+	int fd;			/* file data if not -1 */
+	uint64_t offset;	/* offset into ref, file or staging area */
+	size_t len;
+};
+
+struct iovbuf_data {
+	uint8_t *stage;
+	size_t stage_size;
+	size_t stage_len;
+
+	struct iovbuf_seg *seg;
+	unsigned int seg_count;
+	unsigned int seg_size;
+
+	size_t data_len;
+};
+
+static const void *iovbuf_seg_ptr(const struct iovbuf_data *p,
+				  const struct iovbuf_seg *s) {
+	if (s->fd != -1)
+		return NULL;
+	else if (s->ref)
+		return s->ref + s->offset;
+	else
+		return p->stage + s->offset;
+}
+
+static int iovbuf_set_size(void *self, size_t new_size) {
+	struct iovbuf_data *p = self;
+	uint8_t *tmp;
+
+	if (new_size < p->stage_len)
+		new_size = p->stage_len;
+	if (new_size == p->stage_size)
+		return 0;
+
+	if (new_size == 0) {
+		free(p->stage);
+		p->stage = NULL;
+		p->stage_size = 0;
+		return 0;
+	}
+
+	tmp = realloc(p->stage, new_size);
+	if (!tmp)
+		return -errno;
+
+	p->stage = tmp;
+	p->stage_size = new_size;
+	return 0;
+}
+
+static struct iovbuf_seg *iovbuf_new_seg(struct iovbuf_data *p) {
+	if (p->seg_count == p->seg_size) {
+		unsigned int size = p->seg_size * 2;
+		struct iovbuf_seg *tmp;
+
+		tmp = realloc(p->seg, size * sizeof(*tmp));
+		if (!tmp)
+			return NULL;
+		p->seg = tmp;
+		p->seg_size = size;
+	}
+
+	return &p->seg[p->seg_count++];
+}
+
+static void *iovbuf_new(size_t default_size) {
+	struct iovbuf_data *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+
+	p->seg = malloc(IOVBUF_SEGMENTS * sizeof(*p->seg));
+	if (!p->seg) {
+		free(p);
+		return NULL;
+	}
+	p->seg_size = IOVBUF_SEGMENTS;
+
+	if (iovbuf_set_size(p, default_size) < 0) {
+		free(p->seg);
+		free(p);
+		p = NULL;
+	}
+
+	return (void*)p;
+}
+
+static void iovbuf_delete(void *self) {
+	struct iovbuf_data *p = self;
+
+	if (!p)
+		return;
+	free(p->stage);
+	free(p->seg);
+	free(p);
+}
+
+static size_t iovbuf_get_size(void *self) {
+	struct iovbuf_data *p = self;
+
+	if (!p)
+		return 0;
+	else
+		return p->stage_size;
+}
+
+static size_t iovbuf_get_length(const void *self) {
+	const struct iovbuf_data *p = self;
+
+	if (!p)
+		return 0;
+	else
+		return p->data_len;
+}
+
+/* Only needed by users that cannot handle segments: copy everything into
+ * the staging area so that the content is contiguous. The staged parts
+ * are moved to their place first. Parts that move towards the end are
+ * moved last to first and parts that move towards the front first to
+ * last, so no part overwrites one that was not moved yet. */
+static void* iovbuf_get(const void *self) {
+	struct iovbuf_data *p = (struct iovbuf_data *)self;
+	size_t pos;
+	unsigned int i;
+
+	if (!p)
+		return NULL;
+
+	if (p->seg_count == 0)
+		return p->stage;
+	if (p->seg_count == 1 && p->seg[0].ref == NULL && p->seg[0].fd == -1)
+		return p->stage + p->seg[0].offset;
+
+	DEBUG(4, "Flattening %u segments\n", p->seg_count);
+	if (p->stage_size < p->data_len &&
+	    iovbuf_set_size(p, p->data_len) < 0)
+		return NULL;
+
+	pos = p->data_len;
+	for (i = p->seg_count; i-- > 0;) {
+		struct iovbuf_seg *s = &p->seg[i];
+
+		pos -= s->len;
+		if (s->ref == NULL && s->fd == -1 && s->offset < pos)
+			memmove(p->stage + pos, p->stage + s->offset, s->len);
+	}
+
+	for (i = 0; i < p->seg_count; ++i) {
+		struct iovbuf_seg *s = &p->seg[i];
+
+		if (s->ref == NULL && s->fd == -1 && s->offset > pos)
+			memmove(p->stage + pos, p->stage + s->offset, s->len);
+		pos += s->len;
+	}
+
+	pos = 0;
+	for (i = 0; i < p->seg_count; ++i) {
+		const struct iovbuf_seg *s = &p->seg[i];
+
+		if (s->fd != -1) {
+			if (buf_read_file(s->fd, s->offset, p->stage + pos,
+					  s->len) < 0)
+				return NULL;
+		} else if (s->ref)
+			memcpy(p->stage + pos, s->ref + s->offset, s->len);
+		pos += s->len;
+	}
+
+	p->stage_len = p->data_len;
+	p->seg[0].ref = NULL;
+	p->seg[0].fd = -1;
+	p->seg[0].offset = 0;
+	p->seg[0].len = p->data_len;
+	p->seg_count = 1;
+
+	return p->stage;
+}
+
+static void iovbuf_clear(void *self, size_t len) {
+	struct iovbuf_data *p = self;
+	unsigned int i = 0;
+
+	if (!p || !p->data_len)
+		return;
+
+	if (len >= p->data_len) {
+		p->seg_count = 0;
+		p->stage_len = 0;
+		p->data_len = 0;
+		return;
+	}
+
+	p->data_len -= len;
+	while (len >= p->seg[i].len) {
+		len -= p->seg[i].len;
+		++i;
+	}
+	p->seg[i].offset += len;
+	p->seg[i].len -= len;
+
+	if (i) {
+		p->seg_count -= i;
+		memmove(p->seg, p->seg + i, p->seg_count * sizeof(*p->seg));
+	}
+}
+
+static int iovbuf_append(void *self, const void *data, size_t len) {
+	struct iovbuf_data *p = self;
+	struct iovbuf_seg *s = NULL;
+
+	if (!p)
+		return -EINVAL;
+
+	DEBUG(4, "Request to append %lu bytes\n", (unsigned long)len);
+	if (len > p->stage_size - p->stage_len) {
+		int ret = iovbuf_set_size(p, p->stage_len + len);
+		if (ret < 0) {
+			DEBUG(4, "Resizing failed\n");
+			return ret;
+		}
+	}
+
+	if (p->seg_count) {
+		s = &p->seg[p->seg_count - 1];
+		if (s->ref || s->fd != -1 ||
+		    s->offset + s->len != p->stage_len)
+			s = NULL;
+	}
+	if (!s) {
+		s = iovbuf_new_seg(p);
+		if (!s)
+			return -ENOMEM;
+		s->ref = NULL;
+		s->fd = -1;
+		s->offset = p->stage_len;
+		s->len = 0;
+	}
+
+	if (data)
+		memcpy(p->stage + p->stage_len, data, len);
+	else
+		memset(p->stage + p->stage_len, 0, len);
+	p->stage_len += len;
+	s->len += len;
+	p->data_len += len;
+	return 0;
+}
+
+static int iovbuf_append_ref(void *self, const void *data, size_t len) {
+	struct iovbuf_data *p = self;
+	struct iovbuf_seg *s;
+
+	if (!p || !data)
+		return -EINVAL;
+
+	if (len == 0)
+		return 0;
+
+	DEBUG(4, "Request to reference %lu bytes\n", (unsigned long)len);
+	if (p->seg_count) {
+		s = &p->seg[p->seg_count - 1];
+		if (s->ref && s->ref + s->offset + s->len == data) {
+			s->len += len;
+			p->data_len += len;
+			return 0;
+		}
+	}
+
+	s = iovbuf_new_seg(p);
+	if (!s)
+		return -ENOMEM;
+	s->ref = data;
+	s->fd = -1;
+	s->offset = 0;
+	s->len = len;
+	p->data_len += len;
+	return 0;
+}
+
+static int iovbuf_write(void *self, size_t offset, const void *data,
+			size_t len) {
+	struct iovbuf_data *p = self;
+	const uint8_t *src = data;
+	unsigned int i;
+
+	if (!p || offset + len > p->data_len)
+		return -EINVAL;
+
+	for (i = 0; i < p->seg_count && len; ++i) {
+		struct iovbuf_seg *s = &p->seg[i];
+		size_t n;
+
+		if (offset >= s->len) {
+			offset -= s->len;
+			continue;
+		}
+
+		/* referenced and file data is read-only */
+		if (s->ref || s->fd != -1)
+			return -EINVAL;
+
+		n = s->len - offset;
+		if (n > len)
+			n = len;
+		memcpy(p->stage + s->offset + offset, src, n);
+		src += n;
+		len -= n;
+		offset = 0;
+	}
+
+	return 0;
+}
+
+static int iovbuf_get_vec(const void *self, struct databuffer_vec *vec,
+			  int count) {
+	const struct iovbuf_data *p = self;
+	int i;
+
+	if (!p)
+		return 0;
+
+	for (i = 0; i < count && i < (int)p->seg_count; ++i) {
+		vec[i].base = iovbuf_seg_ptr(p, &p->seg[i]);
+		vec[i].len = p->seg[i].len;
+		vec[i].fd = p->seg[i].fd;
+		vec[i].offset = (p->seg[i].fd != -1)? p->seg[i].offset: 0;
+	}
+
+	return i;
+}
+
+static int iovbuf_append_file(void *self, int fd, uint64_t offset,
+			      size_t len) {
+	struct iovbuf_data *p = self;
+	struct iovbuf_seg *s;
+
+	if (!p || fd == -1)
+		return -EINVAL;
+
+	if (len == 0)
+		return 0;
+
+	DEBUG(4, "Request to append %lu bytes from file\n",
+	      (unsigned long)len);
+	if (p->seg_count) {
+		s = &p->seg[p->seg_count - 1];
+		if (s->fd == fd && s->offset + s->len == offset) {
+			s->len += len;
+			p->data_len += len;
+			return 0;
+		}
+	}
+
+	s = iovbuf_new_seg(p);
+	if (!s)
+		return -ENOMEM;
+	s->ref = NULL;
+	s->fd = fd;
+	s->offset = offset;
+	s->len = len;
+	p->data_len += len;
+	return 0;
+}
+
+static struct databuffer_ops iovbuf_ops = {
+	&iovbuf_new,
+	&iovbuf_delete,
+	NULL,
+	NULL,
+	&iovbuf_get_size,
+	&iovbuf_set_size,
+	&iovbuf_get_length,
+	&iovbuf_get,
+	&iovbuf_clear,
+	&iovbuf_append,
+	&iovbuf_append_ref,
+	&iovbuf_write,
+	&iovbuf_get_vec,
+	&iovbuf_append_file,
+};
+
+struct databuffer *iovbuf_create(size_t default_size) {
+	return buf_create(default_size, &iovbuf_ops);
+}
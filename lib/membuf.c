@@ -207,6 +207,10 @@ static struct databuffer_ops membuf_ops = {
 	&membuf_get,
 	&membuf_clear,
 	&membuf_append,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
 };
 
 struct databuffer *membuf_create(size_t default_size) {
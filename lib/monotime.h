@@ -0,0 +1,66 @@
+/**
+	\file monotime.h
+	monotonic clock wrapper
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef MONOTIME_H
+#define MONOTIME_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/** Current time in milliseconds of a clock that never jumps
+ * This is CLOCK_MONOTONIC on POSIX systems and GetTickCount64() on Windows.
+ */
+static __inline int64_t obex_monotime_ms(void)
+{
+#if defined(_WIN32)
+	return (int64_t)GetTickCount64();
+#else
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return 0;
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+/** Current time in nanoseconds of the same clock, for short intervals */
+static __inline int64_t obex_monotime_ns(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER count, freq;
+
+	if (!QueryPerformanceCounter(&count) ||
+	    !QueryPerformanceFrequency(&freq))
+		return 0;
+	return (int64_t)((double)count.QuadPart * 1e9 / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return 0;
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#endif /* MONOTIME_H */
@@ -27,6 +27,14 @@
 #include <obex_main.h>
 #include <obex_object.h>
 
+/* Largest heap buffer that is allocated up front for a body of announced
+ * length */
+#define OBEX_BODY_PREALLOC_MAX	(4 * OBEX_MAXIMUM_MTU)
+
+/* Largest file that is created up front for a body of announced length.
+ * File blocks do not take memory, this only limits wrong hints. */
+#define OBEX_BODY_SPILL_PREALLOC_MAX	(1024 * 1024 * 1024)
+
 int obex_body_rcv(struct obex_body *self, struct obex_hdr *hdr)
 {
 	if (self && self->ops && self->ops->rcv)
@@ -66,7 +74,8 @@ static int obex_body_stream_rcv(void *self, struct obex_hdr *hdr)
 
 	/* If send send EOS to app */
 	if (id == OBEX_HDR_ID_BODY_END && len != 0) {
-		object->body = obex_hdr_ptr_create(id, type, NULL, 0);
+		object->body = obex_hdr_ptr_create(obex->pool, id, type,
+						   NULL, 0);
 		obex_deliver_event(obex, OBEX_EV_STREAMAVAIL, cmd, 0, FALSE);
 		obex_hdr_destroy(object->body);
 		object->body = NULL;
@@ -112,15 +121,41 @@ static int obex_body_buffered_rcv(void *self, struct obex_hdr *hdr)
 	DEBUG(4, "This is a body-header.\n");
 
 	if (!object->body) {
-		int alloclen = obex_hdr_get_data_size(hdr);
+		size_t prealloc = OBEX_BODY_PREALLOC_MAX;
+		size_t alloclen = object->hinted_body_len;
+		struct databuffer *buf;
+
+		/* Allocate the whole body at once if the peer announced its
+		 * length. The hint may be wrong, the buffer still grows or
+		 * keeps unused space in that case. It is not trusted beyond
+		 * a limit, larger bodies grow as they arrive. A body that
+		 * goes to a file gets the whole file right away. */
+		if (object->body_spill && alloclen > object->body_spill)
+			prealloc = OBEX_BODY_SPILL_PREALLOC_MAX;
+		else if (object->body_spill && object->body_spill < prealloc)
+			prealloc = object->body_spill;
+		if (alloclen > prealloc)
+			alloclen = prealloc;
+		if (alloclen < len)
+			alloclen = len;
+
+		DEBUG(4, "Allocating new body-buffer. Len=%lu\n",
+		      (unsigned long)alloclen);
+		buf = spillbuf_create(alloclen, object->body_spill);
+		if (!buf && alloclen > len)
+			buf = spillbuf_create(len, object->body_spill);
+		if (!buf)
+			return -1;
 
-		if (object->hinted_body_len)
-			alloclen = object->hinted_body_len;
+		if (buf_append(buf, data, len) < 0) {
+			buf_delete(buf);
+			return -1;
+		}
 
-		DEBUG(4, "Allocating new body-buffer. Len=%d\n", alloclen);
-		object->body = obex_hdr_membuf_create(OBEX_HDR_ID_BODY,
-						      OBEX_HDR_TYPE_BYTES,
-						      data, len);
+		object->body = obex_hdr_membuf_create_buf(object->pool,
+							  OBEX_HDR_ID_BODY,
+							  OBEX_HDR_TYPE_BYTES,
+							  buf);
 		if (!object->body)
 			return -1;
 
@@ -136,10 +171,10 @@ static int obex_body_buffered_rcv(void *self, struct obex_hdr *hdr)
 		object->body = NULL;
 
 		/* Add element to rx-list */
-		object->rx_headerq = slist_append(object->rx_headerq, hdr);
-
-		if (object->rx_it == NULL)
-			object->rx_it = obex_hdr_it_create(object->rx_headerq);
+		if (!obex_object_queue_rx(object, hdr)) {
+			obex_hdr_destroy(hdr);
+			return -1;
+		}
 	}
 
 	return 1;
@@ -80,10 +80,12 @@ static result_t obex_client_abort_rx(obex_t *self)
 
 	if (!obex_msg_rx_status(self))
 		return RESULT_SUCCESS;
+	obex_latency_packet_received(self);
 	rsp = msg_get_rsp(self);
 
 	if (rsp == OBEX_RSP_SUCCESS)
 		event = OBEX_EV_ABORT;
+	obex_latency_request_end(self, event == OBEX_EV_ABORT);
 	obex_deliver_event(self, event, self->object->cmd, rsp, true);
 	if (event == OBEX_EV_LINKERR)
 		ret = RESULT_ERROR;
@@ -138,6 +140,7 @@ static result_t obex_client_response_rx(obex_t *self)
 
 	if (!obex_msg_rx_status(self))
 		return RESULT_SUCCESS;
+	obex_latency_packet_received(self);
 	rsp = msg_get_rsp(self);
 
 	switch (self->object->cmd) {
@@ -162,6 +165,7 @@ static result_t obex_client_response_rx(obex_t *self)
 		/* Receive any headers */
 		result_t ret = obex_msg_receive(self, self->object);
 		if (ret == RESULT_ERROR) {
+			obex_latency_request_end(self, false);
 			obex_deliver_event(self, OBEX_EV_PARSEERR,
 					   self->object->cmd, 0, true);
 			self->mode = OBEX_MODE_SERVER;
@@ -178,6 +182,7 @@ static result_t obex_client_response_rx(obex_t *self)
 		if (rsp != OBEX_RSP_SUCCESS ||
 		    obex_parse_connectframe(self, self->object) < 0)
 		{
+			obex_latency_request_end(self, false);
 			obex_deliver_event(self, OBEX_EV_PARSEERR,
 					   self->object->cmd, 0, true);
 			self->mode = OBEX_MODE_SERVER;
@@ -208,6 +213,7 @@ static result_t obex_client_response_rx(obex_t *self)
 
 		/* Notify app that client-operation is done! */
 		DEBUG(3, "Done! Rsp=%02x!\n", rsp);
+		obex_latency_request_end(self, true);
 		obex_deliver_event(self, OBEX_EV_REQDONE, cmd, rsp, true);
 		self->mode = OBEX_MODE_SERVER;
 		self->state = STATE_IDLE;
@@ -249,6 +255,7 @@ static result_t obex_client_request_rx(obex_t *self)
 
 	if (!obex_msg_rx_status(self))
 		return RESULT_SUCCESS;
+	obex_latency_packet_received(self);
 	rsp = msg_get_rsp(self);
 
 	/* Any errors from peer? Win2k will send RSP_SUCCESS after
@@ -260,6 +267,7 @@ static result_t obex_client_request_rx(obex_t *self)
 
 	default:
 		DEBUG(0, "STATE_SEND. request not accepted.\n");
+		obex_latency_request_end(self, true);
 		obex_deliver_event(self, OBEX_EV_REQDONE, self->object->cmd,
 								     rsp, true);
 		/* This is not an Obex error, it is just that the peer
@@ -271,6 +279,7 @@ static result_t obex_client_request_rx(obex_t *self)
 	if (!self->object->abort) {
 		int ret = obex_msg_receive(self, self->object);
 		if (ret < 0) {
+			obex_latency_request_end(self, false);
 			obex_deliver_event(self, OBEX_EV_PARSEERR,
 					   self->object->cmd, 0, true);
 			self->mode = OBEX_MODE_SERVER;
@@ -295,6 +304,8 @@ static result_t obex_client_request_rx(obex_t *self)
 result_t obex_client(obex_t *self)
 {
 	DEBUG(4, "\n");
+	TRACE(self, OBEX_TRACE_STATE, self->state, self->substate);
+	PROBE4(state, self, self->mode, self->state, self->substate);
 
 	switch (self->state) {
 	case STATE_REQUEST:
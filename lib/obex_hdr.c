@@ -21,11 +21,13 @@
  */
 
 #include "obex_hdr.h"
+#include "obex_pool.h"
 #include "defines.h"
 
 #include <string.h>
 
-struct obex_hdr * obex_hdr_create(enum obex_hdr_id id, enum obex_hdr_type type,
+struct obex_hdr * obex_hdr_create(struct obex_pool *pool,
+				  enum obex_hdr_id id, enum obex_hdr_type type,
 				  const void *value, size_t size,
 				  unsigned int flags)
 {
@@ -33,9 +35,9 @@ struct obex_hdr * obex_hdr_create(enum obex_hdr_id id, enum obex_hdr_type type,
 	const unsigned int save_flags = OBEX_FL_SUSPEND;
 
 	if (flags & OBEX_FL_COPY)
-		hdr = obex_hdr_membuf_create(id, type, value, size);
+		hdr = obex_hdr_membuf_create(pool, id, type, value, size);
 	else
-		hdr = obex_hdr_ptr_create(id, type, value, size);
+		hdr = obex_hdr_ptr_create(pool, id, type, value, size);
 
 	if (!hdr)
 		return NULL;
@@ -44,9 +46,10 @@ struct obex_hdr * obex_hdr_create(enum obex_hdr_id id, enum obex_hdr_type type,
 	return hdr;
 }
 
-struct obex_hdr * obex_hdr_new(struct obex_hdr_ops *ops, void *data)
+struct obex_hdr * obex_hdr_new(struct obex_pool *pool,
+			       struct obex_hdr_ops *ops, void *data)
 {
-	struct obex_hdr *hdr = calloc(1, sizeof(*hdr));
+	struct obex_hdr *hdr = obex_pool_zalloc(pool, sizeof(*hdr));
 	if (!hdr) {
 		if (ops && ops->destroy)
 			ops->destroy(data);
@@ -63,7 +66,7 @@ void obex_hdr_destroy(struct obex_hdr *hdr)
 		hdr->ops->destroy(hdr->data);
 	hdr->ops = NULL;
 	hdr->data = NULL;
-	free(hdr);
+	obex_pool_free(hdr);
 }
 
 enum obex_hdr_id obex_hdr_get_id(struct obex_hdr *hdr)
@@ -149,7 +152,11 @@ size_t obex_hdr_append_data(struct obex_hdr *hdr, struct databuffer *buf,
 	if (hdr->ops && hdr->ops->append_data)
 		return hdr->ops->append_data(hdr->data, buf, size);
 
-	buf_append(buf, obex_hdr_get_data_ptr(hdr), size);
+	/* The header data stays valid until the object is deleted */
+	if (size >= OBEX_HDR_REF_MIN)
+		buf_append_ref(buf, obex_hdr_get_data_ptr(hdr), size);
+	else
+		buf_append(buf, obex_hdr_get_data_ptr(hdr), size);
 	hdr->offset += size;
 
 	return size;
@@ -167,7 +174,7 @@ size_t obex_hdr_append(struct obex_hdr *hdr, struct databuffer *buf,
 		       size_t max_size)
 {
 	size_t actual = 0;
-	uint8_t *h;
+	uint8_t h[3];
 	size_t buflen = buf_get_length(buf);
 	size_t hdr_size = obex_hdr_get_hdr_size(hdr);
 	size_t data_size = obex_hdr_get_data_size(hdr);
@@ -177,7 +184,6 @@ size_t obex_hdr_append(struct obex_hdr *hdr, struct databuffer *buf,
 		return 0;
 
 	buf_append(buf, NULL, hdr_size);
-	h = (uint8_t *)buf_get(buf) + buflen;
 	actual += hdr_size;
 	while (max_size > actual && data_size != 0) {
 		size_t ret;
@@ -229,6 +235,7 @@ size_t obex_hdr_append(struct obex_hdr *hdr, struct databuffer *buf,
 		h[1] = (actual >> 8) & 0xFF;
 		h[2] = actual & 0xFF;
 	}
+	buf_write(buf, buflen, h, hdr_size);
 
 	return actual;
 }
@@ -241,25 +248,81 @@ bool obex_hdr_is_finished(struct obex_hdr *hdr)
 		return (obex_hdr_get_data_size(hdr) == 0);
 }
 
+void obex_hdr_queue_init(struct obex_hdr_queue *q)
+{
+	q->hdrs = NULL;
+	q->count = 0;
+	q->size = 0;
+}
+
+/** Destroy all headers in a queue
+ * @param no_delete header that is owned elsewhere and must not be destroyed
+ */
+void obex_hdr_queue_clear(struct obex_hdr_queue *q,
+			  const struct obex_hdr *no_delete)
+{
+	size_t i;
+
+	for (i = 0; i < q->count; ++i) {
+		if (q->hdrs[i] != no_delete)
+			obex_hdr_destroy(q->hdrs[i]);
+	}
+
+	free(q->hdrs);
+	obex_hdr_queue_init(q);
+}
+
+int obex_hdr_queue_append(struct obex_hdr_queue *q, struct obex_hdr *hdr)
+{
+	if (q->count == q->size) {
+		size_t size = q->size ? 2 * q->size : 8;
+		struct obex_hdr **hdrs = realloc(q->hdrs,
+						 size * sizeof(*hdrs));
+
+		if (hdrs == NULL)
+			return -1;
+		q->hdrs = hdrs;
+		q->size = size;
+	}
+
+	q->hdrs[q->count++] = hdr;
+	return 0;
+}
+
+size_t obex_hdr_queue_count(const struct obex_hdr_queue *q)
+{
+	return q->count;
+}
+
+struct obex_hdr * obex_hdr_queue_get(const struct obex_hdr_queue *q,
+				     size_t index)
+{
+	if (index < q->count)
+		return q->hdrs[index];
+	else
+		return NULL;
+}
+
 void obex_hdr_it_init_from(struct obex_hdr_it *it,
 			   const struct obex_hdr_it *from)
 {
 	if (from) {
-		it->list = from->list;
-		it->is_valid = from->is_valid;
+		it->queue = from->queue;
+		it->pos = from->pos;
 	} else {
-		it->list = NULL;
-		it->is_valid = FALSE;
+		it->queue = NULL;
+		it->pos = 0;
 	}
 }
 
-struct obex_hdr_it * obex_hdr_it_create(struct databuffer_list *list)
+struct obex_hdr_it * obex_hdr_it_create(struct obex_pool *pool,
+					const struct obex_hdr_queue *queue)
 {
-	struct obex_hdr_it *it = malloc(sizeof(*it));
+	struct obex_hdr_it *it = obex_pool_alloc(pool, sizeof(*it));
 
 	if (it) {
-		it->list = list;
-		it->is_valid = TRUE;
+		it->queue = queue;
+		it->pos = 0;
 	}
 
 	return it;
@@ -270,30 +333,32 @@ void obex_hdr_it_destroy(struct obex_hdr_it *it)
 	if (it == NULL)
 		return;
 
-	it->list = NULL;
-	free(it);
+	it->queue = NULL;
+	obex_pool_free(it);
 }
 
+/** Get the current header
+ * Headers that are appended to the queue later are still seen by an
+ * iterator that is already at the end.
+ */
 struct obex_hdr * obex_hdr_it_get(const struct obex_hdr_it *it)
 {
-	if (it->is_valid)
-		return slist_get(it->list);
+	if (it->queue)
+		return obex_hdr_queue_get(it->queue, it->pos);
 	else
 		return NULL;
 }
 
 void obex_hdr_it_next(struct obex_hdr_it *it)
 {
-	if (it == NULL)
+	if (it == NULL || it->queue == NULL)
 		return;
 
-	it->is_valid = slist_has_more(it->list);
-
-	if (it->is_valid)
-		it->list = it->list->next;
+	if (it->pos < it->queue->count)
+		it->pos++;
 }
 
 int obex_hdr_it_equals(const struct obex_hdr_it *a, const struct obex_hdr_it *b)
 {
-	return a && b && (memcmp(a, b, sizeof(*a)) == 0);
+	return a && b && a->queue == b->queue && a->pos == b->pos;
 }
@@ -20,10 +20,15 @@
  * along with OpenOBEX. If not, see <http://www.gnu.org/>.
  */
 
+#ifndef OBEX_HDR_H
+#define OBEX_HDR_H
+
 #include <databuffer.h>
 #include <obex_incl.h>
 #include <defines.h>
 
+struct obex_pool;
+
 struct obex_hdr {
 	unsigned int flags;
 	size_t offset;
@@ -34,21 +39,33 @@ struct obex_hdr {
 /** Copy the data to the header instance */
 #define OBEX_FL_COPY		(1 <<  0)
 
-struct obex_hdr * obex_hdr_create(enum obex_hdr_id id, enum obex_hdr_type type,
+/** Header data of at least this size is sent from where it is stored
+ * instead of being copied to the transmit buffer */
+#define OBEX_HDR_REF_MIN	256
+
+struct obex_hdr * obex_hdr_create(struct obex_pool *pool,
+				  enum obex_hdr_id id, enum obex_hdr_type type,
 				  const void *data, size_t size,
 				  unsigned int flags);
 
 
-struct obex_hdr * obex_hdr_membuf_create(enum obex_hdr_id id,
+struct obex_hdr * obex_hdr_membuf_create(struct obex_pool *pool,
+					 enum obex_hdr_id id,
 					 enum obex_hdr_type type,
 					 const void *data, size_t size);
+struct obex_hdr * obex_hdr_membuf_create_buf(struct obex_pool *pool,
+					     enum obex_hdr_id id,
+					     enum obex_hdr_type type,
+					     struct databuffer *buf);
 struct databuffer * obex_hdr_membuf_get_databuffer(struct obex_hdr *hdr);
 
 
-struct obex_hdr * obex_hdr_ptr_create(enum obex_hdr_id id,
+struct obex_hdr * obex_hdr_ptr_create(struct obex_pool *pool,
+				      enum obex_hdr_id id,
 				      enum obex_hdr_type type,
 				      const void *data, size_t size);
-struct obex_hdr * obex_hdr_ptr_parse(const void *msgdata, size_t size);
+struct obex_hdr * obex_hdr_ptr_parse(struct obex_pool *pool,
+				     const void *msgdata, size_t size);
 
 
 struct obex_hdr * obex_hdr_stream_create(struct obex *obex,
@@ -56,6 +73,24 @@ struct obex_hdr * obex_hdr_stream_create(struct obex *obex,
 void obex_hdr_stream_finish(struct obex_hdr *hdr);
 
 
+struct obex_hdr * obex_hdr_file_create(struct obex_pool *pool, int fd,
+				       uint64_t offset, uint64_t length);
+
+
+struct obex_hdr_viewbuf;
+struct obex_hdr_viewbuf * obex_hdr_viewbuf_new(struct obex_pool *pool,
+					       const void *base);
+void obex_hdr_viewbuf_unref(struct obex_hdr_viewbuf *vb);
+bool obex_hdr_viewbuf_in_use(const struct obex_hdr_viewbuf *vb);
+void obex_hdr_viewbuf_set(struct obex_hdr_viewbuf *vb, const void *base,
+			  void *mem);
+struct obex_hdr * obex_hdr_view_create(struct obex_pool *pool,
+				       struct obex_hdr_viewbuf *vb,
+				       enum obex_hdr_id id,
+				       enum obex_hdr_type type,
+				       const void *data, size_t size);
+
+
 struct obex_hdr_ops {
 	void (*destroy)(void *self);
 	enum obex_hdr_id (*get_id)(void *self);
@@ -67,7 +102,8 @@ struct obex_hdr_ops {
 	bool (*is_finished)(void *self);
 };
 
-struct obex_hdr * obex_hdr_new(struct obex_hdr_ops *ops, void *data);
+struct obex_hdr * obex_hdr_new(struct obex_pool *pool,
+			       struct obex_hdr_ops *ops, void *data);
 void obex_hdr_destroy(struct obex_hdr *hdr);
 enum obex_hdr_id obex_hdr_get_id(struct obex_hdr *hdr);
 enum obex_hdr_type obex_hdr_get_type(struct obex_hdr *hdr);
@@ -80,15 +116,33 @@ size_t obex_hdr_append(struct obex_hdr *hdr, struct databuffer *buf,
 bool obex_hdr_is_splittable(struct obex_hdr *hdr);
 bool obex_hdr_is_finished(struct obex_hdr *hdr);
 
+/** Growable array of header pointers */
+struct obex_hdr_queue {
+	struct obex_hdr **hdrs;
+	size_t count;		/* number of queued headers */
+	size_t size;		/* number of allocated entries */
+};
+
+void obex_hdr_queue_init(struct obex_hdr_queue *q);
+void obex_hdr_queue_clear(struct obex_hdr_queue *q,
+			  const struct obex_hdr *no_delete);
+int obex_hdr_queue_append(struct obex_hdr_queue *q, struct obex_hdr *hdr);
+size_t obex_hdr_queue_count(const struct obex_hdr_queue *q);
+struct obex_hdr * obex_hdr_queue_get(const struct obex_hdr_queue *q,
+				     size_t index);
+
 struct obex_hdr_it {
-	struct databuffer_list *list;
-	int is_valid;
+	const struct obex_hdr_queue *queue;
+	size_t pos;
 };
 
 void obex_hdr_it_init_from(struct obex_hdr_it *it,
 			   const struct obex_hdr_it *from);
-struct obex_hdr_it * obex_hdr_it_create(struct databuffer_list *list);
+struct obex_hdr_it * obex_hdr_it_create(struct obex_pool *pool,
+					const struct obex_hdr_queue *queue);
 void obex_hdr_it_destroy(struct obex_hdr_it *it);
 struct obex_hdr * obex_hdr_it_get(const struct obex_hdr_it *it);
 void obex_hdr_it_next(struct obex_hdr_it *it);
 int obex_hdr_it_equals(const struct obex_hdr_it *a, const struct obex_hdr_it *b);
+
+#endif /* OBEX_HDR_H */
@@ -0,0 +1,133 @@
+/**
+ * @file obex_hdr_file.c
+ *
+ * OBEX body header that takes its data from a file.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "obex_hdr.h"
+#include "obex_pool.h"
+#include "debug.h"
+
+#include <stdint.h>
+
+/* The body data is taken from a file region. The bytes are only added as
+ * a file reference to the transmit buffer, so transports that support it
+ * can send them without copying through user space. */
+
+struct obex_hdr_file {
+	int fd;
+	uint64_t offset;
+	uint64_t length;
+	uint64_t pos;
+};
+
+static
+void obex_hdr_file_destroy(void *self)
+{
+	obex_pool_free(self);
+}
+
+static
+enum obex_hdr_id obex_hdr_file_get_id(void *self)
+{
+	struct obex_hdr_file *file = self;
+
+	/* The last part of the data is sent as BODY_END */
+	if (file->pos == file->length)
+		return OBEX_HDR_ID_BODY_END;
+	else
+		return OBEX_HDR_ID_BODY;
+}
+
+static
+enum obex_hdr_type obex_hdr_file_get_type(void *self)
+{
+	(void)self;
+	return OBEX_HDR_TYPE_BYTES;
+}
+
+static
+size_t obex_hdr_file_get_data_size(void *self)
+{
+	struct obex_hdr_file *file = self;
+	uint64_t size = file->length - file->pos;
+
+	if (size > SIZE_MAX)
+		return SIZE_MAX;
+	return (size_t)size;
+}
+
+static
+size_t obex_hdr_file_append_data(void *self, struct databuffer *buf,
+				 size_t size)
+{
+	struct obex_hdr_file *file = self;
+	uint64_t offset = file->offset + file->pos;
+	int ret;
+
+	if (size > file->length - file->pos)
+		size = (size_t)(file->length - file->pos);
+
+	if (size < OBEX_HDR_REF_MIN) {
+		uint8_t data[OBEX_HDR_REF_MIN];
+
+		ret = buf_read_file(file->fd, offset, data, size);
+		if (ret == 0)
+			ret = buf_append(buf, data, size);
+	} else
+		ret = buf_append_file(buf, file->fd, offset, size);
+
+	if (ret < 0) {
+		DEBUG(1, "Cannot add file data: %d\n", ret);
+		return 0;
+	}
+
+	file->pos += size;
+	return size;
+}
+
+static
+struct obex_hdr_ops obex_hdr_file_ops = {
+	&obex_hdr_file_destroy,
+	&obex_hdr_file_get_id,
+	&obex_hdr_file_get_type,
+	&obex_hdr_file_get_data_size,
+	NULL,
+	NULL,
+	&obex_hdr_file_append_data,
+	NULL,
+};
+
+/** Create a body header that takes its data from a file
+ * The file descriptor is not closed and must stay valid until the object
+ * is deleted.
+ */
+struct obex_hdr * obex_hdr_file_create(struct obex_pool *pool, int fd,
+				       uint64_t offset, uint64_t length)
+{
+	struct obex_hdr_file *file = obex_pool_alloc(pool, sizeof(*file));
+
+	if (!file)
+		return NULL;
+
+	file->fd = fd;
+	file->offset = offset;
+	file->length = length;
+	file->pos = 0;
+
+	return obex_hdr_new(pool, &obex_hdr_file_ops, file);
+}
@@ -22,6 +22,7 @@
 
 #include <membuf.h>
 #include <obex_hdr.h>
+#include <obex_pool.h>
 
 #include <string.h>
 
@@ -32,23 +33,17 @@ struct obex_hdr_membuf {
 };
 
 static
-void * obex_hdr_membuf_new(enum obex_hdr_id id, enum obex_hdr_type type,
-			   const void *value, size_t size)
+void * obex_hdr_membuf_new(struct obex_pool *pool, enum obex_hdr_id id,
+			   enum obex_hdr_type type, struct databuffer *buf)
 {
-	struct obex_hdr_membuf *hdr = malloc(sizeof(*hdr));
+	struct obex_hdr_membuf *hdr = obex_pool_alloc(pool, sizeof(*hdr));
 
 	if (!hdr)
 		return NULL;
 
 	hdr->id = id;
 	hdr->type = type;
-	hdr->buf = membuf_create(size);
-	if (hdr->buf == NULL) {
-		free(hdr);
-		return NULL;
-	}
-
-	buf_append(hdr->buf, value, size);
+	hdr->buf = buf;
 	return hdr;
 }
 
@@ -57,7 +52,7 @@ void obex_hdr_membuf_destroy(void *self)
 {
 	struct obex_hdr_membuf *hdr = self;
 	buf_delete(hdr->buf);
-	free(hdr);
+	obex_pool_free(hdr);
 }
 
 static
@@ -111,16 +106,37 @@ struct obex_hdr_ops obex_hdr_membuf_ops = {
 	NULL,
 };
 
-struct obex_hdr * obex_hdr_membuf_create(enum obex_hdr_id id,
+struct obex_hdr * obex_hdr_membuf_create(struct obex_pool *pool,
+					 enum obex_hdr_id id,
 					 enum obex_hdr_type type,
 					 const void *data, size_t size)
 {
-	void *buf = obex_hdr_membuf_new(id, type, data, size);
+	struct databuffer *buf = membuf_create(size);
 
 	if (!buf)
 		return NULL;
 
-	return obex_hdr_new(&obex_hdr_membuf_ops, buf);
+	buf_append(buf, data, size);
+	return obex_hdr_membuf_create_buf(pool, id, type, buf);
+}
+
+/** Create a header that holds the data of a buffer
+ * The header takes over the buffer, the buffer is deleted if the header
+ * cannot be created.
+ */
+struct obex_hdr * obex_hdr_membuf_create_buf(struct obex_pool *pool,
+					     enum obex_hdr_id id,
+					     enum obex_hdr_type type,
+					     struct databuffer *buf)
+{
+	void *data = obex_hdr_membuf_new(pool, id, type, buf);
+
+	if (!data) {
+		buf_delete(buf);
+		return NULL;
+	}
+
+	return obex_hdr_new(pool, &obex_hdr_membuf_ops, data);
 }
 
 struct databuffer * obex_hdr_membuf_get_databuffer(struct obex_hdr *hdr)
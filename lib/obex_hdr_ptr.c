@@ -21,6 +21,7 @@
  */
 
 #include "obex_hdr.h"
+#include "obex_pool.h"
 #include "debug.h"
 
 #ifndef _WIN32
@@ -38,7 +39,7 @@ struct obex_hdr_ptr {
 static
 void obex_hdr_ptr_destroy(void *self)
 {
-	free(self);
+	obex_pool_free(self);
 }
 
 static
@@ -90,11 +91,12 @@ struct obex_hdr_ops obex_hdr_ptr_ops = {
 	NULL,
 };
 
-struct obex_hdr * obex_hdr_ptr_create(enum obex_hdr_id id,
+struct obex_hdr * obex_hdr_ptr_create(struct obex_pool *pool,
+				      enum obex_hdr_id id,
 				      enum obex_hdr_type type,
 				      const void *data, size_t size)
 {
-	struct obex_hdr_ptr *ptr = malloc(sizeof(*ptr));
+	struct obex_hdr_ptr *ptr = obex_pool_alloc(pool, sizeof(*ptr));
 
 	if (!ptr)
 		return NULL;
@@ -104,10 +106,11 @@ struct obex_hdr * obex_hdr_ptr_create(enum obex_hdr_id id,
 	ptr->size = size;
 	ptr->value = data;
 
-	return obex_hdr_new(&obex_hdr_ptr_ops, ptr);
+	return obex_hdr_new(pool, &obex_hdr_ptr_ops, ptr);
 }
 
-struct obex_hdr * obex_hdr_ptr_parse(const void *msgdata, size_t size)
+struct obex_hdr * obex_hdr_ptr_parse(struct obex_pool *pool,
+				     const void *msgdata, size_t size)
 {
 	struct obex_hdr_ptr *ptr;
 	uint16_t hsize;
@@ -115,7 +118,7 @@ struct obex_hdr * obex_hdr_ptr_parse(const void *msgdata, size_t size)
 	if (size < 1)
 		return NULL;
 
-	ptr = malloc(sizeof(*ptr));
+	ptr = obex_pool_alloc(pool, sizeof(*ptr));
 	if (!ptr)
 		return NULL;
 
@@ -152,10 +155,10 @@ struct obex_hdr * obex_hdr_ptr_parse(const void *msgdata, size_t size)
 		goto err;
 	}
 
-	return obex_hdr_new(&obex_hdr_ptr_ops, ptr);
+	return obex_hdr_new(pool, &obex_hdr_ptr_ops, ptr);
 
 err:
 	DEBUG(1, "Header too big.\n");
-	free(ptr);
+	obex_pool_free(ptr);
 	return NULL;
 }
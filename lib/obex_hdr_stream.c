@@ -23,6 +23,7 @@
 #include <obex_hdr.h>
 #include <obex_main.h>
 #include <obex_object.h>
+#include <obex_pool.h>
 
 struct obex_hdr_stream {
 	struct obex *obex;
@@ -41,7 +42,7 @@ void obex_hdr_stream_destroy(void *self)
 {
 	struct obex_hdr_stream *hdr = self;
 	obex_hdr_destroy(hdr->data);
-	free(hdr);
+	obex_pool_free(hdr);
 }
 
 static
@@ -124,7 +125,13 @@ size_t obex_hdr_stream_append_data(void *self, struct databuffer *buf,
 
 	if (size < data_size) {
 		DEBUG(4, "More data than tx_left. Buffer will not be empty\n");
-		buf_append(buf, ptr, size);
+		/* The application is not asked for more data before this
+		 * message was sent, so the data can be referenced. That is
+		 * not true when several SRM packets are sent together. */
+		if (size >= OBEX_HDR_REF_MIN && !hdr->obex->srm_batch)
+			buf_append_ref(buf, ptr, size);
+		else
+			buf_append(buf, ptr, size);
 		hdr->s_offset += size;
 		ret += size;
 
@@ -161,14 +168,15 @@ struct obex_hdr_ops obex_hdr_stream_ops = {
 struct obex_hdr * obex_hdr_stream_create(struct obex *obex,
 					 struct obex_hdr *data)
 {
-	struct obex_hdr_stream *hdr = calloc(1, sizeof(*hdr));
+	struct obex_hdr_stream *hdr = obex_pool_zalloc(obex->pool,
+						       sizeof(*hdr));
 
 	if (!hdr)
 		return NULL;
 	hdr->obex = obex;
 	hdr->data = data;
 
-	return obex_hdr_new(&obex_hdr_stream_ops, hdr);
+	return obex_hdr_new(obex->pool, &obex_hdr_stream_ops, hdr);
 }
 
 void obex_hdr_stream_finish(struct obex_hdr *hdr)
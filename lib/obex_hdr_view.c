@@ -0,0 +1,162 @@
+/**
+ * @file obex_hdr_view.c
+ *
+ * OBEX headers that refer to data of a received message.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "obex_hdr.h"
+#include "obex_pool.h"
+#include "debug.h"
+
+/* A view header points into a received message instead of owning a copy
+ * of its data. All views into one message share a reference counted
+ * memory block. While the message is still in the receive buffer, the
+ * block only knows its address. When the receive buffer is reused, the
+ * message is copied to a pool block that is freed with the last view. */
+
+struct obex_hdr_viewbuf {
+	unsigned int refcount;
+	const uint8_t *base;	/* start of the message */
+	void *mem;		/* owned memory, freed with the last reference */
+};
+
+struct obex_hdr_view {
+	enum obex_hdr_id id;
+	enum obex_hdr_type type;
+	size_t size;
+	size_t offset;		/* data offset relative to base */
+	struct obex_hdr_viewbuf *vb;
+};
+
+struct obex_hdr_viewbuf * obex_hdr_viewbuf_new(struct obex_pool *pool,
+					       const void *base)
+{
+	struct obex_hdr_viewbuf *vb = obex_pool_alloc(pool, sizeof(*vb));
+
+	if (!vb)
+		return NULL;
+
+	vb->refcount = 1;
+	vb->base = base;
+	vb->mem = NULL;
+	return vb;
+}
+
+void obex_hdr_viewbuf_unref(struct obex_hdr_viewbuf *vb)
+{
+	if (--vb->refcount)
+		return;
+
+	obex_pool_free(vb->mem);
+	obex_pool_free(vb);
+}
+
+/** Check if any header views still use the message */
+bool obex_hdr_viewbuf_in_use(const struct obex_hdr_viewbuf *vb)
+{
+	return (vb->refcount > 1);
+}
+
+/** Move the message that the views refer to
+ * @param base new start of the message
+ * @param mem pool memory to free when the last view is gone
+ */
+void obex_hdr_viewbuf_set(struct obex_hdr_viewbuf *vb, const void *base,
+			  void *mem)
+{
+	vb->base = base;
+	vb->mem = mem;
+}
+
+static
+void obex_hdr_view_destroy(void *self)
+{
+	struct obex_hdr_view *view = self;
+
+	obex_hdr_viewbuf_unref(view->vb);
+	obex_pool_free(view);
+}
+
+static
+enum obex_hdr_id obex_hdr_view_get_id(void *self)
+{
+	struct obex_hdr_view *view = self;
+	return view->id;
+}
+
+static
+enum obex_hdr_type obex_hdr_view_get_type(void *self)
+{
+	struct obex_hdr_view *view = self;
+	return view->type;
+}
+
+static
+size_t obex_hdr_view_get_data_size(void *self)
+{
+	struct obex_hdr_view *view = self;
+
+	if (view->vb->base == NULL)
+		return 0;
+	return view->size;
+}
+
+static
+const void * obex_hdr_view_get_data_ptr(void *self)
+{
+	struct obex_hdr_view *view = self;
+
+	if (view->vb->base == NULL)
+		return NULL;
+	return view->vb->base + view->offset;
+}
+
+static
+struct obex_hdr_ops obex_hdr_view_ops = {
+	&obex_hdr_view_destroy,
+	&obex_hdr_view_get_id,
+	&obex_hdr_view_get_type,
+	&obex_hdr_view_get_data_size,
+	&obex_hdr_view_get_data_ptr,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/** Create a header that refers to data of a received message
+ * @param vb the message memory, data must point into it
+ */
+struct obex_hdr * obex_hdr_view_create(struct obex_pool *pool,
+				       struct obex_hdr_viewbuf *vb,
+				       enum obex_hdr_id id,
+				       enum obex_hdr_type type,
+				       const void *data, size_t size)
+{
+	struct obex_hdr_view *view = obex_pool_alloc(pool, sizeof(*view));
+
+	if (!view)
+		return NULL;
+
+	view->id = id;
+	view->type = type;
+	view->size = size;
+	view->offset = (const uint8_t *)data - vb->base;
+	view->vb = vb;
+	vb->refcount++;
+
+	return obex_hdr_new(pool, &obex_hdr_view_ops, view);
+}
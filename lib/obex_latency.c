@@ -0,0 +1,297 @@
+/**
+ * @file obex_latency.c
+ *
+ * Latency histograms of requests.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "obex_latency.h"
+#include "obex_main.h"
+#include "obex_object.h"
+#include "monotime.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The histograms are log-linear like HDR histograms: every power of two
+ * is split into 8 buckets of the same width, so a bucket is never wider
+ * than 1/8 of the values in it. Values below 8ns get a bucket each and
+ * values above 2^40ns (about 18 minutes) go into the last bucket.
+ *
+ * There is one histogram per command and phase. All commands that are
+ * not in 0..7 share the last row. */
+
+#define SUB_BITS	3
+#define SUB_COUNT	(1 << SUB_BITS)
+#define MAX_BITS	40
+#define BUCKETS		((MAX_BITS - SUB_BITS + 1) * SUB_COUNT)
+#define COMMANDS	9
+
+struct obex_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint32_t buckets[BUCKETS];
+};
+
+struct obex_latency {
+	struct obex_histogram hist[COMMANDS][OBEX_LATENCY_PHASES];
+};
+
+static unsigned int msb(uint64_t v)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(v);
+#else
+	unsigned int n = 0;
+
+	while (v >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+static unsigned int bucket_index(uint64_t v)
+{
+	unsigned int e;
+
+	if (v < SUB_COUNT)
+		return (unsigned int)v;
+
+	if (v >> MAX_BITS)
+		return BUCKETS - 1;
+
+	e = msb(v);
+	return (e - SUB_BITS + 1) * SUB_COUNT +
+		(unsigned int)((v >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+/* Highest value that goes into a bucket */
+static uint64_t bucket_value(unsigned int index)
+{
+	unsigned int shift;
+	uint64_t sub;
+
+	if (index < SUB_COUNT)
+		return index;
+
+	shift = index / SUB_COUNT - 1;
+	sub = SUB_COUNT + index % SUB_COUNT;
+	return ((sub + 1) << shift) - 1;
+}
+
+static struct obex_histogram * get_histogram(const struct obex_latency *lat,
+					     uint8_t cmd,
+					     enum obex_latency_phase phase)
+{
+	unsigned int row = (cmd < COMMANDS - 1) ? cmd : COMMANDS - 1;
+
+	if ((unsigned int)phase >= OBEX_LATENCY_PHASES)
+		return NULL;
+
+	return (struct obex_histogram *)&lat->hist[row][phase];
+}
+
+struct obex_latency * obex_latency_create(void)
+{
+	return calloc(1, sizeof(struct obex_latency));
+}
+
+void obex_latency_destroy(struct obex_latency *lat)
+{
+	free(lat);
+}
+
+void obex_latency_reset(struct obex_latency *lat)
+{
+	memset(lat, 0, sizeof(*lat));
+}
+
+/** Add all values of one set of histograms to another */
+void obex_latency_merge(struct obex_latency *dst,
+			const struct obex_latency *src)
+{
+	unsigned int c, p, i;
+
+	for (c = 0; c < COMMANDS; ++c) {
+		for (p = 0; p < OBEX_LATENCY_PHASES; ++p) {
+			struct obex_histogram *d = &dst->hist[c][p];
+			const struct obex_histogram *s = &src->hist[c][p];
+
+			if (s->count == 0)
+				continue;
+
+			d->count += s->count;
+			d->sum += s->sum;
+			if (s->max > d->max)
+				d->max = s->max;
+			for (i = 0; i < BUCKETS; ++i)
+				d->buckets[i] += s->buckets[i];
+		}
+	}
+}
+
+void obex_latency_record(struct obex_latency *lat, uint8_t cmd,
+			 enum obex_latency_phase phase, int64_t ns)
+{
+	struct obex_histogram *h = get_histogram(lat, cmd, phase);
+	uint64_t v = (ns > 0) ? (uint64_t)ns : 0;
+
+	if (h == NULL)
+		return;
+
+	h->count++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+	h->buckets[bucket_index(v)]++;
+}
+
+/** Get a percentile of a histogram
+ * @param p percentile between 0 and 100
+ * @return the highest value of the bucket the percentile falls into,
+ *         but never more than the largest recorded value
+ */
+uint64_t obex_latency_percentile(const struct obex_latency *lat, uint8_t cmd,
+				 enum obex_latency_phase phase, double p)
+{
+	const struct obex_histogram *h = get_histogram(lat, cmd, phase);
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (h == NULL || h->count == 0)
+		return 0;
+
+	if (p < 0.0)
+		p = 0.0;
+	if (p > 100.0)
+		p = 100.0;
+
+	rank = (uint64_t)(p / 100.0 * (double)h->count + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < BUCKETS; ++i) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	if (i == BUCKETS || bucket_value(i) > h->max)
+		return h->max;
+	return bucket_value(i);
+}
+
+void obex_latency_summary(const struct obex_latency *lat, uint8_t cmd,
+			  enum obex_latency_phase phase,
+			  obex_latency_summary_t *summary)
+{
+	const struct obex_histogram *h = get_histogram(lat, cmd, phase);
+
+	memset(summary, 0, sizeof(*summary));
+	if (h == NULL)
+		return;
+
+	summary->count = h->count;
+	summary->sum = h->sum;
+	summary->max = h->max;
+	summary->p50 = obex_latency_percentile(lat, cmd, phase, 50.0);
+	summary->p90 = obex_latency_percentile(lat, cmd, phase, 90.0);
+	summary->p99 = obex_latency_percentile(lat, cmd, phase, 99.0);
+	summary->p999 = obex_latency_percentile(lat, cmd, phase, 99.9);
+}
+
+/** Start timing a request
+ * Called for the first packet of a request, by the server when it is
+ * received and by the client when it is prepared.
+ */
+void obex_latency_request_start(obex_t *self, uint8_t cmd)
+{
+	if (self->latency == NULL)
+		return;
+
+	memset(&self->latency_req, 0, sizeof(self->latency_req));
+	self->latency_req.start = obex_monotime_ns();
+	self->latency_req.cmd = cmd & ~OBEX_FINAL;
+}
+
+/** Stop timing a request
+ * @param done record the request if it ended with a final response or an
+ *        abort, otherwise just forget about it
+ */
+void obex_latency_request_end(obex_t *self, bool done)
+{
+	struct obex_latency_request *req = &self->latency_req;
+
+	if (self->latency == NULL || req->start == 0)
+		return;
+
+	if (done) {
+		obex_latency_record(self->latency, req->cmd,
+				    OBEX_LATENCY_REQUEST,
+				    obex_monotime_ns() - req->start);
+		obex_latency_record(self->latency, req->cmd,
+				    OBEX_LATENCY_APP, req->app);
+		obex_latency_record(self->latency, req->cmd,
+				    OBEX_LATENCY_TRANSPORT, req->transport);
+	}
+
+	memset(req, 0, sizeof(*req));
+}
+
+/** Get the time before a transport call
+ * @return 0 if the call is not timed
+ */
+int64_t obex_latency_transport_start(obex_t *self)
+{
+	if (self->latency == NULL || self->latency_req.start == 0)
+		return 0;
+
+	return obex_monotime_ns();
+}
+
+void obex_latency_transport_end(obex_t *self, int64_t start)
+{
+	if (start && self->latency_req.start)
+		self->latency_req.transport += obex_monotime_ns() - start;
+}
+
+/** Remember when the last part of a packet went to the transport
+ * Only while the peer answers every packet, with SRM there is no round
+ * trip to measure.
+ */
+void obex_latency_packet_sent(obex_t *self)
+{
+	if (self->latency == NULL || self->latency_req.start == 0)
+		return;
+
+	if (self->object && self->object->rsp_mode != OBEX_RSP_MODE_NORMAL)
+		self->latency_req.tx = 0;
+	else
+		self->latency_req.tx = obex_monotime_ns();
+}
+
+void obex_latency_packet_received(obex_t *self)
+{
+	struct obex_latency_request *req = &self->latency_req;
+
+	if (self->latency == NULL || req->tx == 0)
+		return;
+
+	obex_latency_record(self->latency, req->cmd, OBEX_LATENCY_RTT,
+			    obex_monotime_ns() - req->tx);
+	req->tx = 0;
+}
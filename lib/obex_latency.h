@@ -0,0 +1,61 @@
+/**
+ * @file obex_latency.h
+ *
+ * Latency histograms of requests.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_LATENCY_H
+#define OBEX_LATENCY_H
+
+#include "obex_incl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct obex;
+struct obex_latency;
+
+/* Timing of the request that is currently running on a handle */
+struct obex_latency_request {
+	int64_t start;		/* first packet, 0 without a request */
+	int64_t app;		/* time in the event callback */
+	int64_t transport;	/* time in transport reads and writes */
+	int64_t tx;		/* packet sent and reply pending, or 0 */
+	uint8_t cmd;
+};
+
+struct obex_latency * obex_latency_create(void);
+void obex_latency_destroy(struct obex_latency *lat);
+void obex_latency_reset(struct obex_latency *lat);
+void obex_latency_merge(struct obex_latency *dst,
+			const struct obex_latency *src);
+void obex_latency_record(struct obex_latency *lat, uint8_t cmd,
+			 enum obex_latency_phase phase, int64_t ns);
+uint64_t obex_latency_percentile(const struct obex_latency *lat, uint8_t cmd,
+				 enum obex_latency_phase phase, double p);
+void obex_latency_summary(const struct obex_latency *lat, uint8_t cmd,
+			  enum obex_latency_phase phase,
+			  obex_latency_summary_t *summary);
+
+void obex_latency_request_start(struct obex *self, uint8_t cmd);
+void obex_latency_request_end(struct obex *self, bool done);
+int64_t obex_latency_transport_start(struct obex *self);
+void obex_latency_transport_end(struct obex *self, int64_t start);
+void obex_latency_packet_sent(struct obex *self);
+void obex_latency_packet_received(struct obex *self);
+
+#endif /* OBEX_LATENCY_H */
@@ -28,6 +28,7 @@
 #include <winsock2.h>
 #else /* _WIN32 */
 
+#include <poll.h>
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
@@ -47,7 +48,10 @@
 #include "obex_client.h"
 #include "obex_hdr.h"
 #include "obex_msg.h"
+#include "obex_reactor.h"
+#include "obex_pool.h"
 #include "databuffer.h"
+#include "monotime.h"
 
 #include <openobex/obex_const.h>
 
@@ -75,6 +79,11 @@ void obex_library_init(void)
 	env = getenv("OBEX_DUMP");
 	if (env)
 		obex_dump = atoi(env);
+
+	/* Trace all handles and dump the trace on link errors */
+	env = getenv("OBEX_TRACE");
+	if (env)
+		obex_trace_size = (unsigned int)atoi(env);
 }
 
 obex_t * obex_create(obex_event_t eventcb, unsigned int flags)
@@ -85,11 +94,22 @@ obex_t * obex_create(obex_event_t eventcb, unsigned int flags)
 	if (self == NULL)
 		return NULL;
 
+	self->pool = obex_pool_create();
+	if (self->pool == NULL) {
+		free(self);
+		return NULL;
+	}
+
 	self->eventcb = eventcb;
 	self->init_flags = flags;
 	self->mode = OBEX_MODE_SERVER;
 	self->state = STATE_IDLE;
 	self->rsp_mode = OBEX_RSP_MODE_NORMAL;
+	self->accept_batch = 1;
+
+	if (obex_trace_size)
+		obex_set_trace(self, obex_trace_size,
+			       OBEX_TRACE_DUMP_LINKERR);
 
 	/* Safe values.
 	 * Both self->mtu_rx and self->mtu_tx_max can be increased by app
@@ -103,17 +123,55 @@ obex_t * obex_create(obex_event_t eventcb, unsigned int flags)
 	return self;
 }
 
+/** Remove data from the RX message buffer
+ * Header views into the removed data get a copy of the message.
+ */
+static void obex_data_receive_release(obex_t *self, size_t size)
+{
+	buf_t *msg = self->rx_msg;
+	void *mem;
+
+	if (self->rx_view == NULL || !obex_hdr_viewbuf_in_use(self->rx_view)) {
+		buf_clear(msg, size);
+		return;
+	}
+
+	mem = obex_pool_alloc(self->pool, size ? size : 1);
+	if (mem)
+		memcpy(mem, buf_get(msg), size);
+	else
+		DEBUG(1, "No memory for %lu bytes of header views\n",
+		      (unsigned long)size);
+	buf_clear(msg, size);
+	obex_hdr_viewbuf_set(self->rx_view, mem, mem);
+
+	/* The next message gets a new view buffer */
+	obex_hdr_viewbuf_unref(self->rx_view);
+	self->rx_view = NULL;
+}
+
 void obex_destroy(obex_t *self)
 {
+	obex_reactor_detach(self);
+
 	if (self->trans)
 		obex_transport_cleanup(self);
 
 	if (self->tx_msg)
 		buf_delete(self->tx_msg);
 
+	/* Objects may outlive the handle */
+	if (self->rx_view && self->rx_msg)
+		obex_data_receive_release(self, buf_get_length(self->rx_msg));
+	if (self->rx_view)
+		obex_hdr_viewbuf_unref(self->rx_view);
+
 	if (self->rx_msg)
 		buf_delete(self->rx_msg);
 
+	obex_pool_destroy(self->pool);
+	obex_trace_destroy(self->trace);
+	obex_latency_destroy(self->latency);
 	free(self);
 }
 
@@ -133,14 +191,14 @@ int obex_set_mtu(obex_t *self, uint16_t mtu_rx, uint16_t mtu_tx_max)
 	if (self->rx_msg)
 		buf_set_size(self->rx_msg, self->mtu_rx);
 	else
-		self->rx_msg = membuf_create(self->mtu_rx);		
+		self->rx_msg = ringbuf_create(self->mtu_rx);		
 	if (self->rx_msg == NULL)
 		return -ENOMEM;
 
 	if (self->tx_msg)
 		buf_set_size(self->tx_msg, self->mtu_tx_max);
 	else
-		self->tx_msg = membuf_create(self->mtu_tx_max);
+		self->tx_msg = iovbuf_create(self->mtu_tx_max);
 	if (self->tx_msg == NULL)
 		return -ENOMEM;
 
@@ -205,12 +263,37 @@ void obex_deliver_event(obex_t *self, enum obex_event event, enum obex_cmd cmd,
 			enum obex_rsp rsp, bool delete_object)
 {
 	obex_object_t *object = self->object;
+	int64_t start = 0;
 
 	if (delete_object)
 		self->object = NULL;
 
+	TRACE(self, OBEX_TRACE_EVENT, event, (cmd & 0xff) << 8 | (rsp & 0xff));
+	PROBE4(event, self, event, cmd, rsp);
+	if (event == OBEX_EV_LINKERR && self->trace &&
+	    (obex_trace_get_flags(self->trace) & OBEX_TRACE_DUMP_LINKERR))
+		obex_trace_dump(self->trace, "trace");
+
+	if (event == OBEX_EV_STREAMEMPTY)
+		++self->stats.stream_empty;
+	else if (event == OBEX_EV_STREAMAVAIL)
+		++self->stats.stream_avail;
+
+	/* Callbacks that cause further events are only timed once */
+	++self->stats.callbacks;
+	if (self->event_depth++ == 0)
+		start = obex_monotime_ns();
+
 	self->eventcb(self, object, self->mode, event, cmd, rsp);
 
+	if (--self->event_depth == 0) {
+		int64_t elapsed = obex_monotime_ns() - start;
+
+		self->stats.callback_ns += elapsed;
+		if (self->latency_req.start)
+			self->latency_req.app += elapsed;
+	}
+
 	if (delete_object)
 		obex_object_delete(object);
 }
@@ -218,17 +301,36 @@ void obex_deliver_event(obex_t *self, enum obex_event event, enum obex_cmd cmd,
 bool obex_data_request_init(obex_t *self)
 {
 	buf_t *msg = self->tx_msg;
+	size_t size = self->mtu_tx;
+	size_t batch = obex_srm_batch_size(self);
 	int err;
 
+	if (batch > size)
+		size = batch;
+
 	buf_clear(msg, buf_get_length(msg));
-	err = buf_set_size(msg, self->mtu_tx);
+	err = buf_set_size(msg, size);
 	if (err)
 		return false;
 
+	self->tx_msg_start = 0;
+	self->tx_more = false;
 	buf_append(msg, NULL, sizeof(struct obex_common_hdr));
 	return true;
 }
 
+/** Start another packet behind the ones already in the TX message buffer.
+ *
+ * All packets are then sent together, see obex_data_request_init().
+ */
+bool obex_data_request_next(obex_t *self)
+{
+	buf_t *msg = self->tx_msg;
+
+	self->tx_msg_start = buf_get_length(msg);
+	return (buf_append(msg, NULL, sizeof(struct obex_common_hdr)) == 0);
+}
+
 /** Prepare response or command code along with optional headers/data to send.
  *
  * The caller is supposed to reserve the size of struct obex_common_hdr at the
@@ -241,11 +343,18 @@ bool obex_data_request_init(obex_t *self)
 void obex_data_request_prepare(obex_t *self, int opcode)
 {
 	buf_t *msg = self->tx_msg;
-	obex_common_hdr_t *hdr = buf_get(msg);
+	obex_common_hdr_t hdr;
 
-	/* alignment is assured here */
-	hdr->opcode = opcode;
-	hdr->len = htons((uint16_t)buf_get_length(msg));
+	hdr.opcode = opcode;
+	hdr.len = htons((uint16_t)(buf_get_length(msg) - self->tx_msg_start));
+	buf_write(msg, self->tx_msg_start, &hdr, sizeof(hdr));
+
+	TRACE(self, OBEX_TRACE_TX, opcode,
+	      (int)(buf_get_length(msg) - self->tx_msg_start));
+	PROBE3(tx_packet, self, opcode, ntohs(hdr.len));
+	++self->stats.packets_out;
+	if (self->object && self->object->rsp_mode == OBEX_RSP_MODE_SINGLE)
+		++self->stats.srm_packets_out;
 
 	DUMPBUFFER(1, "Tx", msg);
 }
@@ -306,11 +415,22 @@ result_t obex_handle_input(obex_t *self)
 
 	if (obex_transport_is_server(self)) {
 		DEBUG(4, "Data available on server socket\n");
-		if (self->init_flags & OBEX_FL_KEEPSERVER)
-			/* Tell the app to perform the OBEX_Accept() */
-			obex_deliver_event(self, OBEX_EV_ACCEPTHINT, 0, 0, FALSE);
-
-		else
+		if (self->init_flags & OBEX_FL_KEEPSERVER) {
+			unsigned int n = 0;
+			unsigned int count;
+
+			/* Tell the app to perform the OBEX_Accept(), and
+			 * repeat that as long as it does and more connections
+			 * are waiting. */
+			do {
+				count = self->accept_count;
+				obex_deliver_event(self, OBEX_EV_ACCEPTHINT, 0,
+						   0, FALSE);
+			} while (self->accept_count != count &&
+				 ++n < self->accept_batch &&
+				 obex_transport_input_pending(self));
+
+		} else
 			obex_transport_accept(self, self);
 
 		return RESULT_SUCCESS;
@@ -321,13 +441,30 @@ result_t obex_handle_input(obex_t *self)
 	}
 }
 
+/** Check if the next packet may be sent without waiting for the peer */
+bool obex_srm_may_send(obex_t *self)
+{
+	return (self->object &&
+		self->object->rsp_mode == OBEX_RSP_MODE_SINGLE &&
+		!(self->srm_flags & OBEX_SRM_FLAG_WAIT_LOCAL) &&
+		((self->mode == OBEX_MODE_CLIENT && self->state == STATE_REQUEST) ||
+		 (self->mode == OBEX_MODE_SERVER && self->state == STATE_RESPONSE)));
+}
+
+/** Get the number of SRM bytes to send at once
+ * On transports that keep record boundaries, a batch must not be larger
+ * than a record that the peer reads.
+ */
+unsigned int obex_srm_batch_size(obex_t *self)
+{
+	if (self->tx_record && self->srm_batch > self->tx_record)
+		return self->tx_record;
+	return self->srm_batch;
+}
+
 static bool obex_check_srm_input(obex_t *self)
 {
-	if (self->object->rsp_mode == OBEX_RSP_MODE_SINGLE &&
-	    !(self->srm_flags & OBEX_SRM_FLAG_WAIT_LOCAL) &&
-	    ((self->mode == OBEX_MODE_CLIENT && self->state == STATE_REQUEST) ||
-	     (self->mode == OBEX_MODE_SERVER && self->state == STATE_RESPONSE)))
-	{
+	if (obex_srm_may_send(self)) {
 		result_t ret = obex_handle_input(self);
 		if (ret == RESULT_TIMEOUT) {
 			self->substate = SUBSTATE_TX_PREPARE;
@@ -337,6 +474,82 @@ static bool obex_check_srm_input(obex_t *self)
 	return true;
 }
 
+/* Number of obex_work() rounds per obex_process_events() call */
+#define OBEX_WORK_BUDGET 16
+
+/** Check if a handle can make progress without waiting for input */
+bool obex_has_pending_work(obex_t *self)
+{
+	switch (obex_get_data_direction(self)) {
+	case OBEX_DATA_NONE:
+	case OBEX_DATA_OUT:
+		return true;
+
+	case OBEX_DATA_IN:
+	default:
+		return obex_msg_rx_status(self) || obex_srm_may_send(self) ||
+			obex_transport_input_queued(self);
+	}
+}
+
+/** Report what a handle waits for
+ * @param fd the descriptor to watch, or -1 if there is none
+ * @param events poll events to watch the descriptor for
+ * @param deadline monotonic time in milliseconds at which obex_process_events()
+ *        must be called even without events, or -1 if there is none
+ */
+void obex_get_wait_events(obex_t *self, int *fd, short *events,
+			  int64_t *deadline)
+{
+	*fd = obex_transport_get_fd(self);
+
+	*deadline = -1;
+
+	switch (obex_get_data_direction(self)) {
+	case OBEX_DATA_IN:
+		*events = POLLIN;
+		if (obex_has_pending_work(self))
+			*deadline = obex_monotime_ms();
+		break;
+
+	case OBEX_DATA_OUT:
+		*events = POLLOUT;
+		break;
+
+	case OBEX_DATA_NONE:
+	default:
+		*events = 0;
+		*deadline = obex_monotime_ms();
+		break;
+	}
+
+	/* Without a descriptor, there is nothing to wait for */
+	if (*fd == -1 && *events == POLLOUT)
+		*deadline = obex_monotime_ms();
+}
+
+/** Do the work that is possible with the given poll events without blocking
+ * @param revents poll events that were seen on the descriptor
+ * @return like obex_work()
+ */
+result_t obex_process_events(obex_t *self, int revents)
+{
+	int64_t timeout = obex_transport_get_timeout(self);
+	int budget = OBEX_WORK_BUDGET;
+	result_t ret;
+
+	obex_transport_set_timeout(self, 0);
+	obex_transport_set_revents(self, revents);
+	do {
+		ret = obex_work(self);
+	} while (ret == RESULT_SUCCESS && --budget > 0 &&
+		 obex_has_pending_work(self));
+	obex_transport_set_revents(self, -1);
+	obex_transport_set_timeout(self, timeout);
+
+	return ret;
+}
+
 /*
  * Function obex_work (self)
  *
@@ -367,6 +580,8 @@ result_t obex_work(obex_t *self)
 				if (self->object)
 					cmd = obex_object_getcmd(self->object);
 		
+				buf_clear(self->tx_msg,
+					  buf_get_length(self->tx_msg));
 				obex_deliver_event(self, OBEX_EV_LINKERR, cmd,
 						   0, TRUE);
 				self->mode = OBEX_MODE_SERVER;
@@ -387,7 +602,7 @@ result_t obex_data_indication(obex_t *self)
 {
 	obex_common_hdr_t *hdr;
 	buf_t *msg;
-	int actual;
+	int actual = 0;
 	unsigned int size;
 
 	DEBUG(4, "\n");
@@ -396,10 +611,25 @@ result_t obex_data_indication(obex_t *self)
 
 	msg = self->rx_msg;
 
-	/* First we need 3 bytes to be able to know how much data to read */
-	if (buf_get_length(msg) < sizeof(*hdr))  {
-		size_t readsize = sizeof(*hdr) - buf_get_length(msg);
-		actual = obex_transport_read(self, readsize);
+	/* First we need 3 bytes to be able to know how much data to read.
+	 * With read-ahead, as much as is available is read at once and the
+	 * packet gets completed on the next call if necessary. */
+	if (buf_get_length(msg) < sizeof(*hdr) || self->rx_readahead)  {
+		size_t readsize = sizeof(*hdr);
+
+		if (buf_get_length(msg) >= sizeof(*hdr)) {
+			hdr = buf_get(msg);
+			readsize = ntohs(hdr->len);
+		}
+		if (readsize > buf_get_length(msg))
+			readsize -= buf_get_length(msg);
+		else
+			readsize = 0;
+		if (readsize && readsize < self->rx_readahead)
+			readsize = self->rx_readahead;
+
+		if (readsize)
+			actual = obex_transport_read(self, readsize);
 
 		DEBUG(4, "Got %d bytes\n", actual);
 
@@ -410,7 +640,7 @@ result_t obex_data_indication(obex_t *self)
 			obex_deliver_event(self, OBEX_EV_LINKERR, 0, 0, TRUE);
 			return RESULT_ERROR;
 		}
-		if (actual == 0)
+		if (actual == 0 && readsize)
 			return RESULT_TIMEOUT;
 	}
 
@@ -419,8 +649,7 @@ result_t obex_data_indication(obex_t *self)
 		hdr = buf_get(msg);
 		size = ntohs(hdr->len);
 
-		actual = 0;
-		if (buf_get_length(msg) < size) {
+		if (buf_get_length(msg) < size && !self->rx_readahead) {
 			size_t readsize = size - buf_get_length(msg);
 			actual = obex_transport_read(self, readsize);
 
@@ -461,19 +690,190 @@ result_t obex_data_indication(obex_t *self)
 		return RESULT_SUCCESS;
 	}
 
+	PROBE3(rx_packet, self, hdr->opcode, size);
 	DUMPBUFFER(2, "Rx", msg);
 
 	return RESULT_SUCCESS;
 }
 
+/** Run the state machine on a complete packet in the RX message buffer
+ * Stops when the packet was evaluated and all that was to be sent in reply
+ * is written, or when this is not possible without waiting.
+ * @return RESULT_SUCCESS if the handle is ready for the next packet
+ */
+static result_t obex_data_feed_packet(obex_t *self)
+{
+	int budget = OBEX_WORK_BUDGET;
+	result_t ret;
+
+	do {
+		/* The transport must not be asked for input, the buffered
+		 * packet is all there is. */
+		if (obex_get_data_direction(self) == OBEX_DATA_IN) {
+			if (!obex_msg_rx_status(self))
+				return RESULT_SUCCESS;
+			ret = obex_mode(self);
+		} else
+			ret = obex_work(self);
+	} while (ret == RESULT_SUCCESS && --budget > 0);
+
+	if (ret == RESULT_SUCCESS)
+		ret = RESULT_TIMEOUT;
+	return ret;
+}
+
+/** Feed data that holds any number of packets into the RX message buffer
+ * Every complete packet is evaluated right away. Only the packet in
+ * progress is ever kept in the RX message buffer.
+ * @param consumed set to the number of bytes taken from buf
+ * @return number of evaluated packets, -1 on error
+ */
+int obex_data_feed(obex_t *self, const uint8_t *buf, size_t len,
+		   size_t *consumed)
+{
+	buf_t *msg = self->rx_msg;
+	int64_t timeout;
+	result_t ret;
+	size_t done = 0;
+	int count = 0;
+
+	*consumed = 0;
+
+	/* Called from the handle_input transport callback: the state machine
+	 * runs already and continues with the buffered data afterwards. */
+	if (obex_transport_in_input(self)) {
+		if (len && buf_append(msg, buf, len) < 0)
+			return -1;
+		self->stats.bytes_in += len;
+		*consumed = len;
+		return 0;
+	}
+
+	timeout = obex_transport_get_timeout(self);
+	obex_transport_set_timeout(self, 0);
+
+	while (done < len) {
+		obex_common_hdr_t *hdr;
+		size_t have = buf_get_length(msg);
+		size_t want;
+
+		if (have < sizeof(*hdr)) {
+			want = sizeof(*hdr) - have;
+		} else {
+			hdr = buf_get(msg);
+			want = ntohs(hdr->len);
+			if (want < sizeof(*hdr)) {
+				DEBUG(1, "Invalid packet length %lu\n",
+				      (unsigned long)want);
+				count = -1;
+				break;
+			}
+			want -= have;
+		}
+		if (want > len - done)
+			want = len - done;
+
+		if (buf_append(msg, buf + done, want) < 0) {
+			count = -1;
+			break;
+		}
+		self->stats.bytes_in += want;
+		done += want;
+
+		if (!obex_msg_rx_status(self))
+			continue;
+
+		hdr = buf_get(msg);
+		PROBE3(rx_packet, self, hdr->opcode, ntohs(hdr->len));
+		ret = obex_data_feed_packet(self);
+		if (ret == RESULT_ERROR)
+			count = -1;
+		if (ret != RESULT_SUCCESS)
+			break;
+		++count;
+	}
+
+	obex_transport_set_timeout(self, timeout);
+	*consumed = done;
+
+	return count;
+}
+
+/** Get the performance counters of a handle */
+void obex_get_stats(obex_t *self, obex_stats_t *stats)
+{
+	struct obex_pool_stats pool;
+
+	*stats = self->stats;
+	obex_pool_get_stats(self->pool, &pool);
+	stats->allocs = pool.allocs + pool.fallback - self->stats_pool_allocs;
+}
+
+/** Set all performance counters of a handle to zero */
+void obex_reset_stats(obex_t *self)
+{
+	struct obex_pool_stats pool;
+
+	memset(&self->stats, 0, sizeof(self->stats));
+	obex_pool_get_stats(self->pool, &pool);
+	self->stats_pool_allocs = pool.allocs + pool.fallback;
+	if (self->latency)
+		obex_latency_reset(self->latency);
+}
+
+/** Start, resize or stop the event trace of a handle
+ * @param size number of entries to keep, 0 to stop tracing
+ * @param flags OBEX_TRACE_* flags
+ */
+int obex_set_trace(obex_t *self, unsigned int size, unsigned int flags)
+{
+	struct obex_trace *trace = NULL;
+
+	if (size) {
+		trace = obex_trace_create(size, flags);
+		if (trace == NULL)
+			return -1;
+	}
+
+	obex_trace_destroy(self->trace);
+	self->trace = trace;
+	return 0;
+}
+
+/** Start or stop recording latency histograms for a handle
+ * Stopping drops all recorded values.
+ */
+int obex_set_latency(obex_t *self, bool enable)
+{
+	if (!enable) {
+		obex_latency_destroy(self->latency);
+		self->latency = NULL;
+	} else if (self->latency == NULL) {
+		self->latency = obex_latency_create();
+		if (self->latency == NULL)
+			return -1;
+	}
+
+	memset(&self->latency_req, 0, sizeof(self->latency_req));
+	return 0;
+}
+
 /** Remove message from RX message buffer after evaluation */
 void obex_data_receive_finished(obex_t *self)
 {
-	buf_t *msg = self->rx_msg;
 	unsigned int size = obex_msg_get_len(self);
 
 	DEBUG(4, "Pulling %u bytes\n", size);
-	buf_clear(msg, size);
+	if (self->trace) {
+		const obex_common_hdr_t *hdr = buf_get(self->rx_msg);
+
+		TRACE(self, OBEX_TRACE_RX, hdr->opcode, size);
+	}
+	obex_data_receive_release(self, size);
+
+	++self->stats.packets_in;
+	if (self->object && self->object->rsp_mode == OBEX_RSP_MODE_SINGLE)
+		++self->stats.srm_packets_in;
 }
 
 /*
@@ -491,9 +891,11 @@ int obex_cancelrequest(obex_t *self, int nice)
 	/* Abort request without sending abort */
 	if (!nice) {
 		/* Deliver event will delete the object */
-		obex_deliver_event(self, OBEX_EV_ABORT, 0, 0, TRUE);
+		/* The transmit buffer may reference object data */
 		buf_clear(self->tx_msg, buf_get_length(self->tx_msg));
-		buf_clear(self->rx_msg, buf_get_length(self->rx_msg));
+		obex_deliver_event(self, OBEX_EV_ABORT, 0, 0, TRUE);
+		obex_data_receive_release(self,
+					  buf_get_length(self->rx_msg));
 		/* Since we didn't send ABORT to peer we are out of sync
 		 * and need to disconnect transport immediately, so we
 		 * signal link error to app */
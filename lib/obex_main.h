@@ -30,8 +30,13 @@
 
 struct databuffer;
 struct obex_object;
+struct obex_reactor_entry;
+struct obex_runtime_worker;
 
 #include "obex_transport.h"
+#include "obex_trace.h"
+#include "obex_latency.h"
+#include "obex_probe.h"
 #include "defines.h"
 #include "debug.h"
 
@@ -41,6 +46,7 @@ struct obex {
 	uint16_t mtu_tx;		/* Maximum OBEX TX packet size */
 	uint16_t mtu_rx;		/* Maximum OBEX RX packet size */
 	uint16_t mtu_tx_max;		/* Maximum TX we can accept */
+	unsigned int rx_readahead;	/* Bytes to read at once, 0 to disable */
 
 	enum obex_state state;
 	enum obex_substate substate;
@@ -49,9 +55,18 @@ struct obex {
 
 	unsigned int init_flags;
 	unsigned int srm_flags;		/* Flags for single response mode */
+	unsigned int srm_batch;		/* SRM bytes to send at once, 0 to disable */
+	unsigned int tx_record;		/* Largest write the peer reads at once, 0 for any */
+	size_t body_spill;		/* Larger bodies go to a file, 0 to disable */
+	unsigned int accept_batch;	/* Connections to accept per wakeup */
+	unsigned int accept_count;	/* Connections accepted by this server */
 
 	struct databuffer *tx_msg;	/* Reusable transmit message */
+	size_t tx_msg_start;		/* Packet being prepared in tx_msg */
+	bool tx_more;			/* More packets follow tx_msg right away */
 	struct databuffer *rx_msg;	/* Reusable receive message */
+	struct obex_hdr_viewbuf *rx_view; /* Header views into rx_msg */
+	struct obex_pool *pool;		/* Small allocations for objects */
 
 	struct obex_object *object;	/* Current object being transfered */
 	obex_event_t eventcb;		/* Event-callback */
@@ -62,6 +77,16 @@ struct obex {
 	obex_interface_t *interfaces;	/* Array of discovered interfaces */
 	int interfaces_number;		/* Number of discovered interfaces */
 
+	struct obex_reactor_entry *reactor; /* Reactor this handle is registered with */
+	struct obex_runtime_worker *worker; /* Runtime thread that owns this handle */
+
+	obex_stats_t stats;		/* Performance counters */
+	uint64_t stats_pool_allocs;	/* Pool allocations at the last reset */
+	unsigned int event_depth;	/* Nesting of event callbacks */
+	struct obex_trace *trace;	/* Event trace, NULL if disabled */
+	struct obex_latency *latency;	/* Latency histograms, NULL if disabled */
+	struct obex_latency_request latency_req; /* Timing of the current request */
+
 	void * userdata;		/* For user */
 };
 
@@ -77,18 +102,32 @@ struct obex_common_hdr {
 #pragma pack()
 typedef struct obex_common_hdr obex_common_hdr_t;
 
+void obex_get_stats(obex_t *self, obex_stats_t *stats);
+void obex_reset_stats(obex_t *self);
+int obex_set_trace(obex_t *self, unsigned int size, unsigned int flags);
+int obex_set_latency(obex_t *self, bool enable);
+
 void obex_deliver_event(obex_t *self, enum obex_event event, enum obex_cmd cmd,
 			enum obex_rsp rsp, bool delete_object);
 
 result_t obex_handle_input(obex_t *self);
 result_t obex_work(struct obex *self);
 enum obex_data_direction obex_get_data_direction(obex_t *self);
+bool obex_has_pending_work(struct obex *self);
+void obex_get_wait_events(struct obex *self, int *fd, short *events,
+			  int64_t *deadline);
+result_t obex_process_events(struct obex *self, int revents);
+int obex_data_feed(struct obex *self, const uint8_t *buf, size_t len,
+		   size_t *consumed);
+bool obex_srm_may_send(obex_t *self);
+unsigned int obex_srm_batch_size(obex_t *self);
 int obex_get_buffer_status(struct databuffer *msg);
 int obex_data_indication(struct obex *self);
 void obex_data_receive_finished(obex_t *self);
 
 int obex_set_mtu(obex_t *self, uint16_t mtu_rx, uint16_t mtu_tx_max);
 bool obex_data_request_init(struct obex *self);
+bool obex_data_request_next(struct obex *self);
 void obex_data_request_prepare(struct obex *self, int opcode);
 int obex_cancelrequest(struct obex *self, int nice);
 
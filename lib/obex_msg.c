@@ -94,16 +94,22 @@ static bool obex_msg_post_prepare(obex_t *self, obex_object_t *object,
 	return true;
 }
 
-bool obex_msg_prepare(obex_t *self, obex_object_t *object, bool allowfinal)
+static bool obex_msg_prepare_packet(obex_t *self, obex_object_t *object,
+				    bool allowfinal, bool next)
 {
 	buf_t *txmsg = self->tx_msg;
 	uint16_t tx_left = self->mtu_tx - sizeof(struct obex_common_hdr);
 	int real_opcode;
 	struct obex_hdr_it it;
+	bool ok;
 
 	obex_hdr_it_init_from(&it, object->tx_it);
 
-	if (!obex_data_request_init(self))
+	if (next)
+		ok = obex_data_request_next(self);
+	else
+		ok = obex_data_request_init(self);
+	if (!ok)
 		return false;
 
 	if (!obex_object_append_data(object, txmsg, tx_left))
@@ -117,6 +123,39 @@ bool obex_msg_prepare(obex_t *self, obex_object_t *object, bool allowfinal)
 	return obex_msg_post_prepare(self, object, &it, object->tx_it);
 }
 
+/** Check if another SRM packet fits into the TX message buffer */
+static bool obex_msg_batch_has_room(obex_t *self, obex_object_t *object,
+				    bool allowfinal)
+{
+	size_t len = buf_get_length(self->tx_msg);
+	size_t batch = obex_srm_batch_size(self);
+
+	return (batch > len && batch - len >= self->mtu_tx &&
+		!object->abort && !object->suspended &&
+		!obex_object_finished(object, allowfinal) &&
+		obex_srm_may_send(self));
+}
+
+bool obex_msg_prepare(obex_t *self, obex_object_t *object, bool allowfinal)
+{
+	if (!obex_msg_prepare_packet(self, object, allowfinal, false))
+		return false;
+
+	/* In single response mode, the following packets would be sent
+	 * without waiting for the peer anyway, so send them together. */
+	while (obex_msg_batch_has_room(self, object, allowfinal)) {
+		if (!obex_msg_prepare_packet(self, object, allowfinal, true))
+			return false;
+	}
+
+	/* Let the transport know that it does not need to flush yet */
+	self->tx_more = (!object->abort && !object->suspended &&
+			 !obex_object_finished(object, allowfinal) &&
+			 obex_srm_may_send(self));
+
+	return true;
+}
+
 int obex_msg_getspace(obex_t *self, obex_object_t *object, unsigned int flags)
 {
 	size_t objlen = sizeof(struct obex_common_hdr);
@@ -200,6 +239,26 @@ int obex_msg_post_receive(obex_t *self)
 	return 0;
 }
 
+/** Get the view buffer for headers of the current RX message
+ * @return NULL if headers shall be copied
+ */
+static struct obex_hdr_viewbuf * obex_msg_rx_view(obex_t *self)
+{
+	const void *base = buf_get(self->rx_msg);
+
+	if (!(self->init_flags & OBEX_FL_RX_NOCOPY))
+		return NULL;
+
+	if (self->rx_view == NULL)
+		self->rx_view = obex_hdr_viewbuf_new(self->pool, base);
+
+	/* The buffer may have moved since the last message */
+	else if (!obex_hdr_viewbuf_in_use(self->rx_view))
+		obex_hdr_viewbuf_set(self->rx_view, base, NULL);
+
+	return self->rx_view;
+}
+
 int obex_msg_receive_filtered(obex_t *self, obex_object_t *object,
 			      uint64_t filter, bool first_run)
 {
@@ -227,7 +286,10 @@ int obex_msg_receive_filtered(obex_t *self, obex_object_t *object,
 	data += object->headeroffset;
 	len -= object->headeroffset;
 	if (len > 0) {
-		hlen = obex_object_receive_headers(object, data, len, filter);
+		struct obex_hdr_viewbuf *vb = obex_msg_rx_view(self);
+
+		hlen = obex_object_receive_headers(object, data, len, filter,
+						   vb);
 		if (hlen < 0)
 			return hlen;
 	}	
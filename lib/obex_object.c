@@ -35,6 +35,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef S_ISREG
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
 
 /*
  * Function obex_object_new ()
@@ -42,34 +48,22 @@
  *    Create a new OBEX object
  *
  */
-obex_object_t *obex_object_new(void)
+obex_object_t *obex_object_new(struct obex_pool *pool)
 {
 	obex_object_t *object = calloc(1, sizeof(*object));
 
-	if (object != NULL)
+	if (object != NULL) {
+		object->pool = pool;
+		obex_hdr_queue_init(&object->tx_headerq);
+		obex_hdr_queue_init(&object->rx_headerq);
 		obex_object_setrsp(object, OBEX_RSP_NOT_IMPLEMENTED,
 						OBEX_RSP_NOT_IMPLEMENTED);
+		PROBE1(object_new, object);
+	}
 
 	return object;
 }
 
-/*
- * Function free_headerq(q)
- *
- *    Free all headers in a header queue.
- *
- */
-static void free_headerq(slist_t *q, const struct obex_hdr *no_delete)
-{
-	DEBUG(4, "\n");
-	while (!slist_is_empty(q)) {
-		struct obex_hdr *h = slist_get(q);
-		q = slist_remove(q, h);
-		if (h != no_delete)
-			obex_hdr_destroy(h);
-	}
-}
-
 /*
  * Function obex_object_delete (object)
  *
@@ -80,10 +74,11 @@ int obex_object_delete(obex_object_t *object)
 {
 	DEBUG(4, "\n");
 	obex_return_val_if_fail(object != NULL, -1);
+	PROBE2(object_delete, object, object->cmd);
 
 	/* Free the headerqueues */
 	obex_hdr_it_destroy(object->tx_it);
-	free_headerq(object->tx_headerq, object->body);
+	obex_hdr_queue_clear(&object->tx_headerq, object->body);
 	/* Free tx non-header data */
 	if (object->tx_nonhdr_data) {
 		buf_delete(object->tx_nonhdr_data);
@@ -94,7 +89,7 @@ int obex_object_delete(obex_object_t *object)
 	/* Free the headerqueues */
 	obex_hdr_it_destroy(object->it);
 	obex_hdr_it_destroy(object->rx_it);
-	free_headerq(object->rx_headerq, object->body);
+	obex_hdr_queue_clear(&object->rx_headerq, object->body);
 	/* Free rx non-header data */
 	if (object->rx_nonhdr_data) {
 		buf_delete(object->rx_nonhdr_data);
@@ -111,6 +106,41 @@ int obex_object_delete(obex_object_t *object)
 	return 0;
 }
 
+/** Append a header to the TX queue */
+bool obex_object_queue_tx(obex_object_t *object, struct obex_hdr *hdr)
+{
+	if (object->tx_it == NULL) {
+		object->tx_it = obex_hdr_it_create(object->pool,
+						   &object->tx_headerq);
+		if (object->tx_it == NULL)
+			return false;
+	}
+
+	return obex_hdr_queue_append(&object->tx_headerq, hdr) == 0;
+}
+
+/** Append a header to the RX queue */
+bool obex_object_queue_rx(obex_object_t *object, struct obex_hdr *hdr)
+{
+	enum obex_hdr_id id = obex_hdr_get_id(hdr);
+
+	if (object->rx_it == NULL) {
+		object->rx_it = obex_hdr_it_create(object->pool,
+						   &object->rx_headerq);
+		if (object->rx_it == NULL)
+			return false;
+	}
+
+	if (obex_hdr_queue_append(&object->rx_headerq, hdr) < 0)
+		return false;
+
+	/* Remember the first header of each ID for lookups */
+	if (id >= 0 && id <= OBEX_HDR_ID_MASK && object->rx_index[id] == NULL)
+		object->rx_index[id] = hdr;
+
+	return true;
+}
+
 /*
  * Function obex_object_setcmd ()
  *
@@ -146,17 +176,14 @@ size_t obex_object_get_size(obex_object_t *object)
 		objlen += buf_get_length(object->tx_nonhdr_data);
 
 	if (object->tx_it) {
-		struct obex_hdr_it it;
-		struct obex_hdr *hdr;
+		size_t count = obex_hdr_queue_count(&object->tx_headerq);
+		size_t i;
 
-		obex_hdr_it_init_from(&it, object->tx_it);
-		hdr = obex_hdr_it_get(&it);
+		for (i = object->tx_it->pos; i < count; ++i) {
+			struct obex_hdr *hdr;
 
-		while (hdr != NULL) {
+			hdr = obex_hdr_queue_get(&object->tx_headerq, i);
 			objlen += obex_hdr_get_size(hdr);
-
-			obex_hdr_it_next(&it);
-			hdr = obex_hdr_it_get(&it);
 		}
 	}
 
@@ -198,7 +225,10 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 			/* End of stream marker */
 			if (object->body == NULL) {
 				/* A body with a single chunk. */
-				hdr = obex_hdr_ptr_create(OBEX_HDR_ID_BODY_END, OBEX_HDR_TYPE_BYTES, hv.bs, hv_size);
+				hdr = obex_hdr_ptr_create(object->pool,
+							  OBEX_HDR_ID_BODY_END,
+							  OBEX_HDR_TYPE_BYTES,
+							  hv.bs, hv_size);
 				hdr = obex_hdr_stream_create(self, hdr);
 				obex_hdr_stream_finish(hdr);
 			} else {
@@ -207,7 +237,8 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 				obex_hdr_stream_finish(object->body);
 				object->body = NULL;
 				/* ...and add the BODY_END header to the end */
-				hdr = obex_hdr_ptr_create(OBEX_HDR_ID_BODY_END,
+				hdr = obex_hdr_ptr_create(object->pool,
+							  OBEX_HDR_ID_BODY_END,
 							  OBEX_HDR_TYPE_BYTES, NULL, 0);
 			}
 			ret = 1;
@@ -218,7 +249,9 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 			if (object->body == NULL)
 				return -1;
 			obex_hdr_stream_finish(object->body);
-			hdr = obex_hdr_ptr_create(id, OBEX_HDR_TYPE_BYTES, hv.bs, hv_size);
+			hdr = obex_hdr_ptr_create(object->pool, id,
+						  OBEX_HDR_TYPE_BYTES, hv.bs,
+						  hv_size);
 			hdr = obex_hdr_stream_create(self, hdr);
 			object->body = hdr;
 			ret = 1;
@@ -236,7 +269,9 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 			DEBUG(3, "Adding stream\n");
 			if (object->body)
 				return -1;
-			hdr = obex_hdr_ptr_create(id, OBEX_HDR_TYPE_BYTES, hv.bs, hv_size);
+			hdr = obex_hdr_ptr_create(object->pool, id,
+						  OBEX_HDR_TYPE_BYTES, hv.bs,
+						  hv_size);
 			hdr = obex_hdr_stream_create(self, hdr);
 			object->body = hdr;
 			ret = 1;
@@ -284,7 +319,7 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 	}
 
 	flags2 |= (flags & OBEX_FL_SUSPEND);
-	hdr = obex_hdr_create(id, type, value, size, flags2);
+	hdr = obex_hdr_create(object->pool, id, type, value, size, flags2);
 	if (!hdr)
 		return -1;
 
@@ -301,14 +336,59 @@ int obex_object_addheader(obex_t *self, obex_object_t *object, uint8_t hi,
 	}
 
 out:
-	object->tx_headerq = slist_append(object->tx_headerq, hdr);
-
-	if (object->tx_it == NULL)
-		object->tx_it = obex_hdr_it_create(object->tx_headerq);
+	if (!obex_object_queue_tx(object, hdr)) {
+		if (object->body == hdr)
+			object->body = NULL;
+		obex_hdr_destroy(hdr);
+		return -1;
+	}
 
 	return ret;
 }
 
+/** Add a body to an object TX queue that is read from a file */
+int obex_object_add_body_fd(obex_t *self, obex_object_t *object, int fd,
+			    uint64_t offset, uint64_t length,
+			    unsigned int flags)
+{
+	struct obex_hdr *hdr;
+	struct stat st;
+
+	DEBUG(4, "\n");
+
+	if (object == NULL)
+		object = self->object;
+	if (object == NULL || fd < 0)
+		return -1;
+
+	/* A body stream is still open */
+	if (object->body)
+		return -1;
+
+	/* Make sure that the data can be read when it is needed */
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		DEBUG(0, "Not a regular file\n");
+		return -1;
+	}
+	if (offset > (uint64_t)st.st_size ||
+	    length > (uint64_t)st.st_size - offset) {
+		DEBUG(0, "File region out of range\n");
+		return -1;
+	}
+
+	hdr = obex_hdr_file_create(object->pool, fd, offset, length);
+	if (!hdr)
+		return -1;
+	hdr->flags |= (flags & OBEX_FL_SUSPEND);
+
+	if (!obex_object_queue_tx(object, hdr)) {
+		obex_hdr_destroy(hdr);
+		return -1;
+	}
+
+	return 1;
+}
+
 enum obex_cmd obex_object_getcmd(const obex_object_t *object)
 {
 	return object->cmd;
@@ -406,6 +486,43 @@ int obex_object_finished(obex_object_t *object, bool allowfinal)
 		allowfinal);
 }
 
+/*
+ * Function obex_object_get_hdr_value()
+ *
+ * Decode the value of a received header
+ *
+ */
+static int obex_object_get_hdr_value(struct obex_hdr *h,
+				     obex_headerdata_t *hv, uint32_t *hv_size)
+{
+	const uint8_t *bq1;
+	const uint32_t *bq4;
+
+	*hv_size= (uint32_t)obex_hdr_get_data_size(h);
+
+	switch (obex_hdr_get_type(h)) {
+	case OBEX_HDR_TYPE_BYTES:
+	case OBEX_HDR_TYPE_UNICODE:
+		hv->bs = obex_hdr_get_data_ptr(h);
+		break;
+
+	case OBEX_HDR_TYPE_UINT32:
+		bq4 = obex_hdr_get_data_ptr(h);
+		hv->bq4 = ntohl(*bq4);
+		break;
+
+	case OBEX_HDR_TYPE_UINT8:
+		bq1 = obex_hdr_get_data_ptr(h);
+		hv->bq1 = bq1[0];
+		break;
+
+	default:
+		return -1;
+	}
+
+	return 1;
+}
+
 /*
  * Function obex_object_getnextheader()
  *
@@ -415,18 +532,17 @@ int obex_object_finished(obex_object_t *object, bool allowfinal)
 int obex_object_getnextheader(obex_object_t *object, uint8_t *hi,
 			      obex_headerdata_t *hv, uint32_t *hv_size)
 {
-	const uint8_t *bq1;
-	const uint32_t *bq4;
 	struct obex_hdr *h;
 
 	DEBUG(4, "\n");
 
 	/* No more headers */
-	if (slist_is_empty(object->rx_headerq))
+	if (obex_hdr_queue_count(&object->rx_headerq) == 0)
 		return 0;
 
 	if (!object->it)
-		object->it = obex_hdr_it_create(object->rx_headerq);
+		object->it = obex_hdr_it_create(object->pool,
+						&object->rx_headerq);
 
 	if (!object->it)
 		return -1;
@@ -438,29 +554,26 @@ int obex_object_getnextheader(obex_object_t *object, uint8_t *hi,
 	obex_hdr_it_next(object->it);
 
 	*hi = obex_hdr_get_id(h) | obex_hdr_get_type(h);
-	*hv_size= (uint32_t)obex_hdr_get_data_size(h);
-
-	switch (obex_hdr_get_type(h)) {
-	case OBEX_HDR_TYPE_BYTES:
-	case OBEX_HDR_TYPE_UNICODE:
-		hv->bs = obex_hdr_get_data_ptr(h);
-		break;
+	return obex_object_get_hdr_value(h, hv, hv_size);
+}
 
-	case OBEX_HDR_TYPE_UINT32:
-		bq4 = obex_hdr_get_data_ptr(h);
-		hv->bq4 = ntohl(*bq4);
-		break;
+/*
+ * Function obex_object_findheader()
+ *
+ * Return the first received header with identifier hi
+ *
+ */
+int obex_object_findheader(obex_object_t *object, uint8_t hi,
+			   obex_headerdata_t *hv, uint32_t *hv_size)
+{
+	struct obex_hdr *h = object->rx_index[hi & OBEX_HDR_ID_MASK];
 
-	case OBEX_HDR_TYPE_UINT8:
-		bq1 = obex_hdr_get_data_ptr(h);
-		hv->bq1 = bq1[0];
-		break;
+	DEBUG(4, "\n");
 
-	default:
-		return -1;
-	}
+	if (h == NULL || obex_hdr_get_type(h) != (hi & OBEX_HDR_TYPE_MASK))
+		return 0;
 
-	return 1;
+	return obex_object_get_hdr_value(h, hv, hv_size);
 }
 
 /*
@@ -548,7 +661,8 @@ int obex_object_receive_body(obex_object_t *object, struct obex_hdr *hdr)
 }
 
 static
-int obex_object_rcv_one_header(obex_object_t *object, struct obex_hdr *hdr)
+int obex_object_rcv_one_header(obex_object_t *object, struct obex_hdr *hdr,
+			       struct obex_hdr_viewbuf *view)
 {
 	enum obex_hdr_id id = obex_hdr_get_id(hdr);
 	enum obex_hdr_type type = obex_hdr_get_type(hdr);
@@ -557,15 +671,20 @@ int obex_object_rcv_one_header(obex_object_t *object, struct obex_hdr *hdr)
 
 	DEBUG(4, "\n");
 
-	hdr = obex_hdr_membuf_create(id, type, data, len);
+	if (view)
+		hdr = obex_hdr_view_create(object->pool, view, id, type,
+					   data, len);
+	else
+		hdr = obex_hdr_membuf_create(object->pool, id, type, data,
+					     len);
 	if (hdr == NULL)
 		return -1;
 
 	/* Add element to rx-list */
-	object->rx_headerq = slist_append(object->rx_headerq, hdr);
-
-	if (object->rx_it == NULL)
-		object->rx_it = obex_hdr_it_create(object->rx_headerq);
+	if (!obex_object_queue_rx(object, hdr)) {
+		obex_hdr_destroy(hdr);
+		return -1;
+	}
 
 	return 0;
 }
@@ -574,11 +693,13 @@ int obex_object_rcv_one_header(obex_object_t *object, struct obex_hdr *hdr)
  * Function obex_object_receive_headers()
  *
  *    Add any incoming headers to headerqueue but does not remove them from
- *    the message buffer.
+ *    the message buffer. With a view buffer, the queued headers refer to
+ *    the message data instead of copying it.
  *    Returns the total number of bytes of the added headers or -1;
  */
 int obex_object_receive_headers(struct obex_object *object, const void *msgdata,
-				size_t tx_left, uint64_t filter)
+				size_t tx_left, uint64_t filter,
+				struct obex_hdr_viewbuf *view)
 {
 	size_t offset = 0;
 	int consumed = 0;
@@ -588,7 +709,8 @@ int obex_object_receive_headers(struct obex_object *object, const void *msgdata,
 	DEBUG(4, "\n");
 
 	while (offset < tx_left) {
-		struct obex_hdr *hdr = obex_hdr_ptr_parse((uint8_t *)msgdata + offset,
+		struct obex_hdr *hdr = obex_hdr_ptr_parse(object->pool,
+							  (uint8_t *)msgdata + offset,
 							  tx_left - offset);
 		size_t hlen;
 		int err = 0;
@@ -631,7 +753,8 @@ int obex_object_receive_headers(struct obex_object *object, const void *msgdata,
 
 			header_bit = (uint64_t) 1 << id;
 			if (!(filter & header_bit)) {
-				err = obex_object_rcv_one_header(object, hdr);
+				err = obex_object_rcv_one_header(object, hdr,
+								 view);
 				consumed += hlen;
 			}
 			obex_hdr_destroy(hdr);
@@ -24,6 +24,7 @@
 #define OBEX_OBJECT_H
 
 #include "obex_incl.h"
+#include "obex_hdr.h"
 #include "defines.h"
 
 #if ! defined(_WIN32)
@@ -33,17 +34,19 @@
 
 
 struct databuffer;
-struct databuffer_list;
+struct obex_hdr_viewbuf;
+struct obex_pool;
 
 struct obex_object {
 	struct databuffer *tx_nonhdr_data;	/* Data before of headers (like CONNECT and SETPATH) */
-	struct databuffer_list *tx_headerq;	/* List of headers to transmit*/
+	struct obex_hdr_queue tx_headerq;	/* Headers to transmit */
 	struct obex_hdr_it *tx_it;
 
 	struct databuffer *rx_nonhdr_data;	/* Data before of headers (like CONNECT and SETPATH) */
-	struct databuffer_list *rx_headerq;	/* List of received headers */
+	struct obex_hdr_queue rx_headerq;	/* Received headers */
 	struct obex_hdr_it *rx_it;
 	struct obex_hdr_it *it;
+	struct obex_hdr *rx_index[OBEX_HDR_ID_MASK + 1]; /* First received header per ID */
 
 	enum obex_cmd cmd;		/* command */
 	enum obex_rsp rsp;		/* response */
@@ -59,17 +62,27 @@ struct obex_object {
 
 	struct obex_hdr *body;		/* The body header need some extra help */
 	struct obex_body *body_rcv;	/* Deliver body */
+	size_t body_spill;		/* Larger buffered bodies go to a file */
+
+	struct obex_pool *pool;		/* Headers are allocated from here */
 };
 
-struct obex_object *obex_object_new(void);
+struct obex_object *obex_object_new(struct obex_pool *pool);
 int obex_object_delete(struct obex_object *object);
 size_t obex_object_get_size(obex_object_t *object);
+bool obex_object_queue_tx(struct obex_object *object, struct obex_hdr *hdr);
+bool obex_object_queue_rx(struct obex_object *object, struct obex_hdr *hdr);
 int obex_object_addheader(struct obex *self, struct obex_object *object, uint8_t hi,
 			  obex_headerdata_t hv, uint32_t hv_size,
 			  unsigned int flags);
+int obex_object_add_body_fd(struct obex *self, struct obex_object *object,
+			    int fd, uint64_t offset, uint64_t length,
+			    unsigned int flags);
 int obex_object_getnextheader(struct obex_object *object, uint8_t *hi,
 			      obex_headerdata_t *hv, uint32_t *hv_size);
 int obex_object_reparseheaders(struct obex_object *object);
+int obex_object_findheader(struct obex_object *object, uint8_t hi,
+			   obex_headerdata_t *hv, uint32_t *hv_size);
 void obex_object_setcmd(struct obex_object *object, enum obex_cmd cmd);
 enum obex_cmd obex_object_getcmd(const obex_object_t *object);
 int obex_object_setrsp(struct obex_object *object, enum obex_rsp rsp,
@@ -83,7 +96,8 @@ int obex_object_finished(obex_object_t *object, bool allowfinal);
 int obex_object_receive_nonhdr_data(obex_object_t *object, const void *msgdata,
 				    size_t rx_left);
 int obex_object_receive_headers(struct obex_object *object, const void *msgdata,
-				size_t tx_left, uint64_t filter);
+				size_t tx_left, uint64_t filter,
+				struct obex_hdr_viewbuf *view);
 
 int obex_object_set_body_receiver(obex_object_t *object, struct obex_body *b);
 const void * obex_object_read_body(obex_object_t *object, size_t *size);
@@ -0,0 +1,218 @@
+/**
+ * @file obex_pool.c
+ *
+ * Small object allocator for headers and header lists.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "obex_pool.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Every packet creates and destroys several small structures (headers,
+ * their private data, list nodes and iterators). They are taken from
+ * per-class free lists that are filled from larger slabs, so that the
+ * system allocator is only used when a pool grows.
+ *
+ * Each block carries a small prefix that names its pool, so it can be
+ * released without knowing where it came from. Blocks that are too big
+ * for the pool, or that are allocated without a pool, are plain malloc()
+ * memory with the same prefix. */
+
+#define POOL_CLASS_STEP		16
+#define POOL_CLASS_COUNT	8	/* up to 128 bytes */
+#define POOL_SLAB_SIZE		4096
+
+union obex_pool_block {
+	struct {
+		struct obex_pool *pool;	/* NULL for malloc() memory */
+		unsigned int cls;
+	} hdr;
+	union obex_pool_block *next;	/* when on a free list */
+	long double align;
+	void *align_ptr;
+	uint64_t align_u64;
+};
+
+struct obex_pool_slab {
+	struct obex_pool_slab *next;
+	union obex_pool_block data[1];
+};
+
+struct obex_pool {
+	union obex_pool_block *free[POOL_CLASS_COUNT];
+	struct obex_pool_slab *slabs;
+	struct obex_pool_stats stats;
+	int destroyed;	/* owner is gone, free with the last block */
+};
+
+struct obex_pool * obex_pool_create(void)
+{
+	return calloc(1, sizeof(struct obex_pool));
+}
+
+static void obex_pool_release(struct obex_pool *pool)
+{
+	while (pool->slabs) {
+		struct obex_pool_slab *slab = pool->slabs;
+
+		pool->slabs = slab->next;
+		free(slab);
+	}
+	free(pool);
+}
+
+/** Destroy a pool
+ * Blocks that are still in use (e.g. objects that the application did not
+ * delete yet) stay valid, the pool memory is freed with the last of them.
+ */
+void obex_pool_destroy(struct obex_pool *pool)
+{
+	if (pool == NULL)
+		return;
+
+	DEBUG(3, "pool: %llu allocs, %llu reused, %llu fallback, %u slabs\n",
+	      (unsigned long long)pool->stats.allocs,
+	      (unsigned long long)pool->stats.reused,
+	      (unsigned long long)pool->stats.fallback, pool->stats.slabs);
+
+	if (pool->stats.in_use) {
+		pool->destroyed = 1;
+		return;
+	}
+	obex_pool_release(pool);
+}
+
+void obex_pool_get_stats(const struct obex_pool *pool,
+			 struct obex_pool_stats *stats)
+{
+	if (pool)
+		*stats = pool->stats;
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+/** Number of block units (including the prefix) for a class */
+static size_t obex_pool_units(unsigned int cls)
+{
+	size_t size = (cls + 1) * POOL_CLASS_STEP;
+	size_t unit = sizeof(union obex_pool_block);
+
+	return 1 + (size + unit - 1) / unit;
+}
+
+/** Carve a new slab into blocks of one class */
+static int obex_pool_grow(struct obex_pool *pool, unsigned int cls)
+{
+	size_t units = obex_pool_units(cls);
+	size_t count = (POOL_SLAB_SIZE - sizeof(struct obex_pool_slab))
+					/ (units * sizeof(union obex_pool_block));
+	struct obex_pool_slab *slab;
+	size_t i;
+
+	if (count == 0)
+		count = 1;
+
+	slab = malloc(sizeof(*slab) +
+		      count * units * sizeof(union obex_pool_block));
+	if (slab == NULL)
+		return -1;
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->stats.slabs++;
+
+	for (i = 0; i < count; ++i) {
+		union obex_pool_block *b = &slab->data[i * units];
+
+		b->next = pool->free[cls];
+		pool->free[cls] = b;
+	}
+
+	return 0;
+}
+
+void * obex_pool_alloc(struct obex_pool *pool, size_t size)
+{
+	union obex_pool_block *b;
+	unsigned int cls;
+
+	if (size == 0)
+		size = 1;
+	cls = (unsigned int)((size - 1) / POOL_CLASS_STEP);
+
+	if (pool == NULL || cls >= POOL_CLASS_COUNT) {
+		b = malloc(sizeof(*b) + size);
+		if (b == NULL)
+			return NULL;
+		b->hdr.pool = NULL;
+		b->hdr.cls = 0;
+		if (pool)
+			pool->stats.fallback++;
+		return b + 1;
+	}
+
+	if (pool->free[cls])
+		pool->stats.reused++;
+	else if (obex_pool_grow(pool, cls) < 0)
+		return NULL;
+
+	b = pool->free[cls];
+	pool->free[cls] = b->next;
+	b->hdr.pool = pool;
+	b->hdr.cls = cls;
+
+	pool->stats.allocs++;
+	pool->stats.in_use++;
+	return b + 1;
+}
+
+void * obex_pool_zalloc(struct obex_pool *pool, size_t size)
+{
+	void *ptr = obex_pool_alloc(pool, size);
+
+	if (ptr)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
+void obex_pool_free(void *ptr)
+{
+	union obex_pool_block *b;
+	struct obex_pool *pool;
+	unsigned int cls;
+
+	if (ptr == NULL)
+		return;
+
+	b = (union obex_pool_block *)ptr - 1;
+	pool = b->hdr.pool;
+	cls = b->hdr.cls;
+	if (pool == NULL) {
+		free(b);
+		return;
+	}
+
+	b->next = pool->free[cls];
+	pool->free[cls] = b;
+	pool->stats.frees++;
+	pool->stats.in_use--;
+
+	if (pool->destroyed && pool->stats.in_use == 0)
+		obex_pool_release(pool);
+}
@@ -0,0 +1,47 @@
+/**
+ * @file obex_pool.h
+ *
+ * Small object allocator for headers and header lists.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_POOL_H
+#define OBEX_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct obex_pool;
+
+struct obex_pool_stats {
+	uint64_t allocs;	/* number of allocations from the pool */
+	uint64_t frees;		/* number of blocks given back */
+	uint64_t reused;	/* allocations served from a free list */
+	uint64_t fallback;	/* allocations too big for the pool */
+	unsigned int slabs;	/* slabs currently allocated */
+	unsigned int in_use;	/* blocks currently allocated */
+};
+
+struct obex_pool * obex_pool_create(void);
+void obex_pool_destroy(struct obex_pool *pool);
+void obex_pool_get_stats(const struct obex_pool *pool,
+			 struct obex_pool_stats *stats);
+
+void * obex_pool_alloc(struct obex_pool *pool, size_t size);
+void * obex_pool_zalloc(struct obex_pool *pool, size_t size);
+void obex_pool_free(void *ptr);
+
+#endif /* OBEX_POOL_H */
@@ -0,0 +1,64 @@
+/**
+ * @file obex_probe.h
+ *
+ * Static tracepoints (USDT) for SystemTap, perf and bpftrace.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_PROBE_H
+#define OBEX_PROBE_H
+
+/* All probes belong to the provider "openobex". A probe is a single no-op
+ * instruction until a tracer attaches to it, e.g.
+ *
+ *   bpftrace -e 'usdt:libopenobex.so:openobex:rx_packet
+ *                { @[arg1] = hist(arg2); }'
+ *
+ * Probe          Arguments
+ * rx_packet      handle, opcode, length
+ * tx_packet      handle, opcode, length
+ * read           handle, requested size, result
+ * write          handle, size, result
+ * state          handle, mode, state, substate
+ * event          handle, event, command, response
+ * object_new     object
+ * object_delete  object, command
+ *
+ * Without sys/sdt.h or with OBEX_USDT off the probes are compiled out.
+ */
+
+#if defined(HAVE_SYS_SDT_H)
+#include <sys/sdt.h>
+
+#define PROBE1(name, a) \
+	DTRACE_PROBE1(openobex, name, a)
+#define PROBE2(name, a, b) \
+	DTRACE_PROBE2(openobex, name, a, b)
+#define PROBE3(name, a, b, c) \
+	DTRACE_PROBE3(openobex, name, a, b, c)
+#define PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(openobex, name, a, b, c, d)
+
+#else
+
+#define PROBE1(name, a)			do { } while (0)
+#define PROBE2(name, a, b)		do { } while (0)
+#define PROBE3(name, a, b, c)		do { } while (0)
+#define PROBE4(name, a, b, c, d)	do { } while (0)
+
+#endif
+
+#endif /* OBEX_PROBE_H */
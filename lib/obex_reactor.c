@@ -0,0 +1,537 @@
+/**
+ * @file obex_reactor.c
+ *
+ * Event loop driving many OBEX handles from one wait set.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "obex_main.h"
+#include "obex_transport.h"
+#include "obex_msg.h"
+#include "obex_reactor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+/* Number of obex_work() rounds a handle gets per wakeup before the other
+ * handles are served again. */
+#define REACTOR_WORK_BUDGET 16
+
+/* Number of ready handles fetched from the kernel at once */
+#define REACTOR_MAX_EVENTS 64
+
+struct obex_reactor_entry {
+	struct obex_reactor *reactor;
+	obex_t *handle;
+	int fd;			/* registered descriptor or -1 */
+	short events;		/* registered POLLIN/POLLOUT mask */
+	bool removed;		/* removed while dispatching */
+	struct obex_reactor_entry *prev;
+	struct obex_reactor_entry *next;
+};
+
+struct obex_reactor {
+	struct obex_reactor_entry *entries;
+	struct obex_reactor_entry *dead;
+	unsigned int count;
+	bool running;
+	int wake[2];		/* pipe to interrupt a wait, or -1 */
+#ifdef HAVE_SYS_EPOLL_H
+	int epfd;
+#else
+	struct pollfd *pfd;
+	struct obex_reactor_entry **ready;
+	unsigned int size;
+#endif
+};
+
+struct obex_reactor * obex_reactor_create(void)
+{
+	struct obex_reactor *reactor = calloc(1, sizeof(*reactor));
+
+	if (reactor == NULL)
+		return NULL;
+
+	reactor->wake[0] = -1;
+	reactor->wake[1] = -1;
+
+#ifdef HAVE_SYS_EPOLL_H
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reactor->epfd == -1) {
+		DEBUG(0, "Cannot create epoll set: %d\n", errno);
+		free(reactor);
+		return NULL;
+	}
+#endif
+
+	return reactor;
+}
+
+/** Poll events a handle currently waits for */
+static short reactor_wanted_events(obex_t *self)
+{
+	/* A complete message that is already buffered will not wake us
+	 * up, so ask for an (almost) immediate wakeup instead. */
+	if (obex_msg_rx_status(self))
+		return POLLIN | POLLOUT;
+
+	/* In single response mode, the sender only waits for input that
+	 * may interrupt it and otherwise continues on timeout. */
+	if (self->substate == SUBSTATE_RX && obex_srm_may_send(self))
+		return POLLIN | POLLOUT;
+
+	switch (obex_get_data_direction(self)) {
+	case OBEX_DATA_IN:
+		return POLLIN;
+
+	case OBEX_DATA_OUT:
+	case OBEX_DATA_NONE:
+	default:
+		return POLLOUT;
+	}
+}
+
+static void reactor_unregister(struct obex_reactor_entry *e)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (e->fd != -1)
+		(void)epoll_ctl(e->reactor->epfd, EPOLL_CTL_DEL, e->fd, NULL);
+#endif
+	e->fd = -1;
+	e->events = 0;
+}
+
+/** Bring the wait set in line with the state of a handle */
+static void reactor_arm(struct obex_reactor_entry *e)
+{
+	int fd = obex_transport_get_fd(e->handle);
+	short events = reactor_wanted_events(e->handle);
+
+	if (fd == e->fd && events == e->events)
+		return;
+
+	/* A changed descriptor means that the old one was closed by the
+	 * transport (e.g. accept without OBEX_FL_KEEPSERVER), and the
+	 * kernel already dropped it from the wait set. */
+	if (fd != e->fd) {
+		e->fd = -1;
+		e->events = 0;
+	}
+
+	if (fd == -1)
+		return;
+
+#ifdef HAVE_SYS_EPOLL_H
+	{
+		int epfd = e->reactor->epfd;
+		struct epoll_event ev;
+		int ret;
+
+		memset(&ev, 0, sizeof(ev));
+		if (events & POLLIN)
+			ev.events |= EPOLLIN;
+		if (events & POLLOUT)
+			ev.events |= EPOLLOUT;
+		ev.data.ptr = e;
+
+		if (e->fd == -1) {
+			ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+			if (ret == -1 && errno == EEXIST)
+				ret = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+		} else {
+			ret = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+			if (ret == -1 && errno == ENOENT)
+				ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+		}
+		if (ret == -1) {
+			DEBUG(0, "Cannot watch descriptor %d: %d\n", fd, errno);
+			e->fd = -1;
+			e->events = 0;
+			return;
+		}
+	}
+#endif
+
+	e->fd = fd;
+	e->events = events;
+}
+
+int obex_reactor_add(struct obex_reactor *reactor, obex_t *self)
+{
+	struct obex_reactor_entry *e = self->reactor;
+
+	if (e != NULL) {
+		if (e->reactor != reactor)
+			return -EBUSY;
+
+		/* re-arm a parked handle */
+		reactor_unregister(e);
+		reactor_arm(e);
+		return 0;
+	}
+
+	if (obex_transport_get_fd(self) == -1)
+		return -EINVAL;
+
+	e = calloc(1, sizeof(*e));
+	if (e == NULL)
+		return -ENOMEM;
+
+	e->reactor = reactor;
+	e->handle = self;
+	e->fd = -1;
+
+	e->next = reactor->entries;
+	if (e->next)
+		e->next->prev = e;
+	reactor->entries = e;
+	reactor->count++;
+
+	self->reactor = e;
+	reactor_arm(e);
+
+	return 0;
+}
+
+int obex_reactor_remove(struct obex_reactor *reactor, obex_t *self)
+{
+	struct obex_reactor_entry *e = self->reactor;
+
+	if (e == NULL || e->reactor != reactor)
+		return -ENOENT;
+
+	reactor_unregister(e);
+
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		reactor->entries = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	reactor->count--;
+
+	self->reactor = NULL;
+	e->handle = NULL;
+	e->removed = true;
+
+	/* The entry may still be referenced by the ready list */
+	if (reactor->running) {
+		e->next = reactor->dead;
+		reactor->dead = e;
+	} else
+		free(e);
+
+	return 0;
+}
+
+/** Called when a registered handle gets destroyed */
+void obex_reactor_detach(obex_t *self)
+{
+	if (self->reactor)
+		obex_reactor_remove(self->reactor->reactor, self);
+}
+
+/** Allow other threads to interrupt obex_reactor_run() */
+int obex_reactor_enable_wakeup(struct obex_reactor *reactor)
+{
+	int i;
+
+	if (reactor->wake[0] != -1)
+		return 0;
+
+	if (pipe(reactor->wake) == -1)
+		return -errno;
+
+	for (i = 0; i < 2; ++i) {
+		(void)fcntl(reactor->wake[i], F_SETFD, FD_CLOEXEC);
+		(void)fcntl(reactor->wake[i], F_SETFL,
+			    fcntl(reactor->wake[i], F_GETFL) | O_NONBLOCK);
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	{
+		struct epoll_event ev;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = reactor;
+		if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->wake[0],
+			      &ev) == -1) {
+			int err = -errno;
+
+			close(reactor->wake[0]);
+			close(reactor->wake[1]);
+			reactor->wake[0] = reactor->wake[1] = -1;
+			return err;
+		}
+	}
+#endif
+
+	return 0;
+}
+
+/** Interrupt a running or the next call to obex_reactor_run()
+ *
+ * This may be called from any thread.
+ */
+void obex_reactor_wakeup(struct obex_reactor *reactor)
+{
+	char c = 0;
+
+	if (reactor->wake[1] != -1)
+		(void)write(reactor->wake[1], &c, 1);
+}
+
+static void reactor_drain_wakeup(struct obex_reactor *reactor)
+{
+	char buf[64];
+
+	while (read(reactor->wake[0], buf, sizeof(buf)) > 0)
+		;
+}
+
+void obex_reactor_destroy(struct obex_reactor *reactor)
+{
+	while (reactor->entries)
+		obex_reactor_remove(reactor, reactor->entries->handle);
+
+	if (reactor->wake[0] != -1) {
+		close(reactor->wake[0]);
+		close(reactor->wake[1]);
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	close(reactor->epfd);
+#else
+	free(reactor->pfd);
+	free(reactor->ready);
+#endif
+	free(reactor);
+}
+
+static void reactor_dispatch(struct obex_reactor_entry *e, int revents)
+{
+	obex_t *self = e->handle;
+	int64_t timeout = obex_transport_get_timeout(self);
+	int budget = REACTOR_WORK_BUDGET;
+	result_t ret;
+
+	/* Readiness is already known, the transport must not block */
+	obex_transport_set_timeout(self, 0);
+	obex_transport_set_revents(self, revents);
+	do {
+		ret = obex_work(self);
+	} while (ret == RESULT_SUCCESS && !e->removed && --budget > 0 &&
+		 obex_has_pending_work(self));
+	obex_transport_set_revents(self, -1);
+	obex_transport_set_timeout(self, timeout);
+
+	if (e->removed)
+		return;
+
+	/* Park the handle until the application re-adds it */
+	if (ret == RESULT_ERROR) {
+		DEBUG(2, "Parking handle after error\n");
+		reactor_unregister(e);
+		return;
+	}
+
+	reactor_arm(e);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static int reactor_revents(uint32_t events)
+{
+	int revents = 0;
+
+	if (events & EPOLLIN)
+		revents |= POLLIN;
+	if (events & EPOLLOUT)
+		revents |= POLLOUT;
+	if (events & EPOLLERR)
+		revents |= POLLERR;
+	if (events & EPOLLHUP)
+		revents |= POLLHUP;
+	return revents;
+}
+
+static int reactor_wait(struct obex_reactor *reactor, int timeout)
+{
+	struct epoll_event ev[REACTOR_MAX_EVENTS];
+	int i, n;
+
+	n = epoll_wait(reactor->epfd, ev, REACTOR_MAX_EVENTS, timeout);
+	if (n == -1)
+		return (errno == EINTR)? 0: -errno;
+
+	for (i = 0; i < n; ++i) {
+		struct obex_reactor_entry *e = ev[i].data.ptr;
+
+		if (ev[i].data.ptr == reactor)
+			reactor_drain_wakeup(reactor);
+		else if (!e->removed)
+			reactor_dispatch(e, reactor_revents(ev[i].events));
+	}
+
+	return n;
+}
+
+#else
+static int reactor_wait(struct obex_reactor *reactor, int timeout)
+{
+	struct obex_reactor_entry *e;
+	unsigned int nfds = 0;
+	unsigned int i;
+	int n;
+
+	if (reactor->size < reactor->count + 1) {
+		unsigned int size = (reactor->count + 1) * 2;
+		struct pollfd *pfd;
+		struct obex_reactor_entry **ready;
+
+		pfd = realloc(reactor->pfd, size * sizeof(*pfd));
+		if (pfd == NULL)
+			return -ENOMEM;
+		reactor->pfd = pfd;
+
+		ready = realloc(reactor->ready, size * sizeof(*ready));
+		if (ready == NULL)
+			return -ENOMEM;
+		reactor->ready = ready;
+		reactor->size = size;
+	}
+
+	if (reactor->wake[0] != -1) {
+		reactor->pfd[nfds].fd = reactor->wake[0];
+		reactor->pfd[nfds].events = POLLIN;
+		reactor->pfd[nfds].revents = 0;
+		reactor->ready[nfds] = NULL;
+		++nfds;
+	}
+
+	for (e = reactor->entries; e != NULL; e = e->next) {
+		if (e->fd == -1)
+			continue;
+		reactor->pfd[nfds].fd = e->fd;
+		reactor->pfd[nfds].events = e->events;
+		reactor->pfd[nfds].revents = 0;
+		reactor->ready[nfds] = e;
+		++nfds;
+	}
+
+	n = poll(reactor->pfd, nfds, timeout);
+	if (n == -1)
+		return (errno == EINTR)? 0: -errno;
+
+	for (i = 0; i < nfds; ++i) {
+		e = reactor->ready[i];
+		if (!reactor->pfd[i].revents)
+			continue;
+		if (e == NULL)
+			reactor_drain_wakeup(reactor);
+		else if (!e->removed)
+			reactor_dispatch(e, reactor->pfd[i].revents);
+	}
+
+	return n;
+}
+#endif
+
+int obex_reactor_run(struct obex_reactor *reactor, int64_t timeout)
+{
+	int ret;
+
+	/* Must not be called from within an event callback */
+	if (reactor->running)
+		return -EBUSY;
+
+	if (timeout > INT_MAX)
+		timeout = INT_MAX;
+	else if (timeout < 0)
+		timeout = -1;
+
+	reactor->running = true;
+	ret = reactor_wait(reactor, (int)timeout);
+	reactor->running = false;
+
+	while (reactor->dead) {
+		struct obex_reactor_entry *e = reactor->dead;
+
+		reactor->dead = e->next;
+		free(e);
+	}
+
+	return ret;
+}
+
+#else /* _WIN32 */
+
+#ifndef ESOCKTNOSUPPORT
+#define ESOCKTNOSUPPORT WSAESOCKTNOSUPPORT
+#endif
+
+struct obex_reactor * obex_reactor_create(void)
+{
+	return NULL;
+}
+
+void obex_reactor_destroy(struct obex_reactor *reactor)
+{
+}
+
+int obex_reactor_add(struct obex_reactor *reactor, obex_t *self)
+{
+	return -ESOCKTNOSUPPORT;
+}
+
+int obex_reactor_remove(struct obex_reactor *reactor, obex_t *self)
+{
+	return -ENOENT;
+}
+
+int obex_reactor_run(struct obex_reactor *reactor, int64_t timeout)
+{
+	return -ESOCKTNOSUPPORT;
+}
+
+void obex_reactor_detach(obex_t *self)
+{
+}
+
+int obex_reactor_enable_wakeup(struct obex_reactor *reactor)
+{
+	return -ESOCKTNOSUPPORT;
+}
+
+void obex_reactor_wakeup(struct obex_reactor *reactor)
+{
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,42 @@
+/**
+ * @file obex_reactor.h
+ *
+ * Event loop driving many OBEX handles from one wait set.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_REACTOR_H
+#define OBEX_REACTOR_H
+
+#include "obex_incl.h"
+#include "defines.h"
+
+struct obex;
+struct obex_reactor;
+
+struct obex_reactor * obex_reactor_create(void);
+void obex_reactor_destroy(struct obex_reactor *reactor);
+
+int obex_reactor_add(struct obex_reactor *reactor, struct obex *self);
+int obex_reactor_remove(struct obex_reactor *reactor, struct obex *self);
+int obex_reactor_run(struct obex_reactor *reactor, int64_t timeout);
+
+void obex_reactor_detach(struct obex *self);
+
+int obex_reactor_enable_wakeup(struct obex_reactor *reactor);
+void obex_reactor_wakeup(struct obex_reactor *reactor);
+
+#endif /* OBEX_REACTOR_H */
@@ -0,0 +1,475 @@
+/**
+ * @file obex_runtime.c
+ *
+ * Worker threads that each run a reactor for a share of the handles.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "obex_main.h"
+#include "obex_transport.h"
+#include "obex_reactor.h"
+#include "obex_runtime.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+#if defined(HAVE_PTHREAD) && !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+
+/* A handle is only ever used by the worker thread that owns it, so the
+ * event callbacks of one handle never run concurrently. Other threads
+ * only post commands to a worker and wake it up.
+ *
+ * New handles go to the worker with the fewest handles. A worker that
+ * found nothing to do for a while asks the busiest worker to hand over
+ * one of its handles. */
+
+/* Milliseconds without events after which a worker looks for work */
+#define RUNTIME_IDLE_TIMEOUT 100
+
+enum runtime_op {
+	RUNTIME_ADD,
+	RUNTIME_CLOSE,
+};
+
+struct runtime_cmd {
+	enum runtime_op op;
+	obex_t *handle;
+	struct runtime_cmd *next;
+};
+
+struct obex_runtime_worker {
+	struct obex_runtime *rt;
+	pthread_t thread;
+	bool started;
+	struct obex_reactor *reactor;
+
+	/* only used by the worker thread */
+	obex_t **handles;
+	unsigned int count;
+	unsigned int size;
+
+	/* protected by the runtime lock */
+	unsigned int load;		/* handles owned, including queued ones */
+	struct runtime_cmd *inbox;
+	struct runtime_cmd **inbox_tail;
+	struct obex_runtime_worker *thief; /* idle worker asking for a handle */
+};
+
+struct obex_runtime {
+	pthread_mutex_t lock;
+	bool stop;
+	unsigned int count;
+	struct obex_runtime_worker *workers;
+};
+
+static struct runtime_cmd *runtime_cmd_new(enum runtime_op op, obex_t *self)
+{
+	struct runtime_cmd *cmd = malloc(sizeof(*cmd));
+
+	if (cmd) {
+		cmd->op = op;
+		cmd->handle = self;
+		cmd->next = NULL;
+	}
+	return cmd;
+}
+
+/** Queue a command for a worker, the runtime lock must be held */
+static void runtime_post(struct obex_runtime_worker *w,
+			 struct runtime_cmd *cmd)
+{
+	*w->inbox_tail = cmd;
+	w->inbox_tail = &cmd->next;
+}
+
+static int worker_take(struct obex_runtime_worker *w, obex_t *self)
+{
+	if (w->count == w->size) {
+		unsigned int size = w->size ? 2 * w->size : 16;
+		obex_t **handles = realloc(w->handles,
+					   size * sizeof(*handles));
+
+		if (handles == NULL)
+			return -ENOMEM;
+		w->handles = handles;
+		w->size = size;
+	}
+
+	w->handles[w->count++] = self;
+	return 0;
+}
+
+static void worker_drop(struct obex_runtime_worker *w, obex_t *self)
+{
+	unsigned int i;
+
+	for (i = 0; i < w->count; ++i) {
+		if (w->handles[i] == self) {
+			w->handles[i] = w->handles[--w->count];
+			return;
+		}
+	}
+}
+
+static void worker_close(struct obex_runtime_worker *w, obex_t *self)
+{
+	obex_reactor_remove(w->reactor, self);
+	worker_drop(w, self);
+
+	pthread_mutex_lock(&w->rt->lock);
+	w->load--;
+	pthread_mutex_unlock(&w->rt->lock);
+
+	obex_destroy(self);
+}
+
+static void worker_add(struct obex_runtime_worker *w, obex_t *self)
+{
+	int err;
+
+	/* A handle that is already registered only gets re-armed */
+	if (self->reactor == NULL) {
+		err = worker_take(w, self);
+		if (err < 0)
+			goto fail;
+	}
+
+	err = obex_reactor_add(w->reactor, self);
+	if (err < 0)
+		goto fail;
+	return;
+
+fail:
+	DEBUG(0, "Cannot run handle: %d\n", err);
+	worker_close(w, self);
+}
+
+/** Run all commands that were posted to a worker */
+static void worker_process(struct obex_runtime_worker *w)
+{
+	struct runtime_cmd *cmd;
+
+	pthread_mutex_lock(&w->rt->lock);
+	cmd = w->inbox;
+	w->inbox = NULL;
+	w->inbox_tail = &w->inbox;
+	pthread_mutex_unlock(&w->rt->lock);
+
+	while (cmd) {
+		struct runtime_cmd *next = cmd->next;
+
+		switch (cmd->op) {
+		case RUNTIME_ADD:
+			worker_add(w, cmd->handle);
+			break;
+
+		case RUNTIME_CLOSE:
+			worker_close(w, cmd->handle);
+			break;
+		}
+
+		free(cmd);
+		cmd = next;
+	}
+}
+
+/** Hand a handle over to an idle worker that asked for one */
+static void worker_give(struct obex_runtime_worker *w)
+{
+	struct obex_runtime *rt = w->rt;
+	struct obex_runtime_worker *thief;
+	struct runtime_cmd *cmd;
+	obex_t *self;
+
+	pthread_mutex_lock(&rt->lock);
+	thief = w->thief;
+	w->thief = NULL;
+	pthread_mutex_unlock(&rt->lock);
+
+	if (thief == NULL || w->count == 0)
+		return;
+
+	self = w->handles[w->count - 1];
+	cmd = runtime_cmd_new(RUNTIME_ADD, self);
+	if (cmd == NULL)
+		return;
+
+	/* The new owner must find the handle unregistered */
+	obex_reactor_remove(w->reactor, self);
+	w->count--;
+
+	pthread_mutex_lock(&rt->lock);
+	if (self->worker != w) {
+		/* Closed meanwhile, the close command is still queued */
+		pthread_mutex_unlock(&rt->lock);
+		free(cmd);
+		return;
+	}
+	self->worker = thief;
+	w->load--;
+	thief->load++;
+	runtime_post(thief, cmd);
+	pthread_mutex_unlock(&rt->lock);
+
+	DEBUG(3, "Moved handle to an idle worker\n");
+	obex_reactor_wakeup(thief->reactor);
+}
+
+/** Ask the busiest worker for a handle */
+static void worker_steal(struct obex_runtime_worker *w)
+{
+	struct obex_runtime *rt = w->rt;
+	struct obex_runtime_worker *victim = NULL;
+	unsigned int i;
+
+	pthread_mutex_lock(&rt->lock);
+	for (i = 0; i < rt->count; ++i) {
+		struct obex_runtime_worker *v = &rt->workers[i];
+
+		if (v != w && v->load > w->load + 1 &&
+		    (victim == NULL || v->load > victim->load))
+			victim = v;
+	}
+	if (victim && victim->thief == NULL)
+		victim->thief = w;
+	else
+		victim = NULL;
+	pthread_mutex_unlock(&rt->lock);
+
+	if (victim)
+		obex_reactor_wakeup(victim->reactor);
+}
+
+static void *worker_main(void *arg)
+{
+	struct obex_runtime_worker *w = arg;
+	struct obex_runtime *rt = w->rt;
+
+	for (;;) {
+		bool stop;
+		int ret;
+
+		pthread_mutex_lock(&rt->lock);
+		stop = rt->stop;
+		pthread_mutex_unlock(&rt->lock);
+		if (stop)
+			break;
+
+		worker_process(w);
+		worker_give(w);
+
+		ret = obex_reactor_run(w->reactor, RUNTIME_IDLE_TIMEOUT);
+		if (ret == 0)
+			worker_steal(w);
+		else if (ret < 0)
+			DEBUG(0, "Reactor failed: %d\n", ret);
+	}
+
+	return NULL;
+}
+
+struct obex_runtime * obex_runtime_create(unsigned int workers)
+{
+	struct obex_runtime *rt;
+	unsigned int i;
+
+	if (workers == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		workers = (n > 0)? (unsigned int)n: 1;
+	}
+
+	rt = calloc(1, sizeof(*rt));
+	if (rt == NULL)
+		return NULL;
+
+	rt->workers = calloc(workers, sizeof(*rt->workers));
+	if (rt->workers == NULL) {
+		free(rt);
+		return NULL;
+	}
+	pthread_mutex_init(&rt->lock, NULL);
+	rt->count = workers;
+
+	for (i = 0; i < workers; ++i) {
+		struct obex_runtime_worker *w = &rt->workers[i];
+
+		w->rt = rt;
+		w->inbox_tail = &w->inbox;
+		w->reactor = obex_reactor_create();
+		if (w->reactor == NULL ||
+		    obex_reactor_enable_wakeup(w->reactor) < 0)
+			goto out_err;
+	}
+
+	for (i = 0; i < workers; ++i) {
+		struct obex_runtime_worker *w = &rt->workers[i];
+
+		if (pthread_create(&w->thread, NULL, &worker_main, w) != 0)
+			goto out_err;
+		w->started = true;
+	}
+
+	return rt;
+
+out_err:
+	obex_runtime_destroy(rt);
+	return NULL;
+}
+
+void obex_runtime_destroy(struct obex_runtime *rt)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&rt->lock);
+	rt->stop = true;
+	pthread_mutex_unlock(&rt->lock);
+
+	for (i = 0; i < rt->count; ++i) {
+		struct obex_runtime_worker *w = &rt->workers[i];
+
+		if (w->started)
+			obex_reactor_wakeup(w->reactor);
+	}
+
+	for (i = 0; i < rt->count; ++i) {
+		struct obex_runtime_worker *w = &rt->workers[i];
+
+		if (w->started)
+			pthread_join(w->thread, NULL);
+	}
+
+	/* The threads are gone, so their handles can be deleted here */
+	for (i = 0; i < rt->count; ++i) {
+		struct obex_runtime_worker *w = &rt->workers[i];
+
+		if (w->reactor == NULL)
+			continue;
+
+		worker_process(w);
+		while (w->count)
+			worker_close(w, w->handles[w->count - 1]);
+
+		obex_reactor_destroy(w->reactor);
+		free(w->handles);
+	}
+
+	pthread_mutex_destroy(&rt->lock);
+	free(rt->workers);
+	free(rt);
+}
+
+int obex_runtime_add(struct obex_runtime *rt, obex_t *self)
+{
+	struct obex_runtime_worker *w;
+	struct runtime_cmd *cmd;
+	unsigned int i;
+
+	if (obex_transport_get_fd(self) == -1)
+		return -EINVAL;
+
+	cmd = runtime_cmd_new(RUNTIME_ADD, self);
+	if (cmd == NULL)
+		return -ENOMEM;
+
+	pthread_mutex_lock(&rt->lock);
+	w = self->worker;
+	if (w == NULL) {
+		if (self->reactor != NULL) {
+			/* registered with a reactor of the application */
+			pthread_mutex_unlock(&rt->lock);
+			free(cmd);
+			return -EBUSY;
+		}
+
+		w = &rt->workers[0];
+		for (i = 1; i < rt->count; ++i) {
+			if (rt->workers[i].load < w->load)
+				w = &rt->workers[i];
+		}
+		self->worker = w;
+		w->load++;
+
+	} else if (w->rt != rt) {
+		pthread_mutex_unlock(&rt->lock);
+		free(cmd);
+		return -EBUSY;
+	}
+	runtime_post(w, cmd);
+	pthread_mutex_unlock(&rt->lock);
+
+	obex_reactor_wakeup(w->reactor);
+	return 0;
+}
+
+int obex_runtime_close(struct obex_runtime *rt, obex_t *self)
+{
+	struct obex_runtime_worker *w;
+	struct runtime_cmd *cmd;
+
+	cmd = runtime_cmd_new(RUNTIME_CLOSE, self);
+	if (cmd == NULL)
+		return -ENOMEM;
+
+	pthread_mutex_lock(&rt->lock);
+	w = self->worker;
+	if (w == NULL || w->rt != rt) {
+		pthread_mutex_unlock(&rt->lock);
+		free(cmd);
+		return -ENOENT;
+	}
+	self->worker = NULL;
+	runtime_post(w, cmd);
+	pthread_mutex_unlock(&rt->lock);
+
+	/* From an event callback, the handle must not be dispatched
+	 * anymore. It is deleted when the worker is done with it. */
+	if (w->started && pthread_equal(pthread_self(), w->thread))
+		obex_reactor_remove(w->reactor, self);
+	else
+		obex_reactor_wakeup(w->reactor);
+
+	return 0;
+}
+
+#else /* HAVE_PTHREAD */
+
+struct obex_runtime * obex_runtime_create(unsigned int workers)
+{
+	return NULL;
+}
+
+void obex_runtime_destroy(struct obex_runtime *rt)
+{
+}
+
+int obex_runtime_add(struct obex_runtime *rt, obex_t *self)
+{
+	return -ENOSYS;
+}
+
+int obex_runtime_close(struct obex_runtime *rt, obex_t *self)
+{
+	return -ENOENT;
+}
+
+#endif /* HAVE_PTHREAD */
@@ -0,0 +1,36 @@
+/**
+ * @file obex_runtime.h
+ *
+ * Worker threads that each run a reactor for a share of the handles.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_RUNTIME_H
+#define OBEX_RUNTIME_H
+
+#include "obex_incl.h"
+#include "defines.h"
+
+struct obex;
+struct obex_runtime;
+
+struct obex_runtime * obex_runtime_create(unsigned int workers);
+void obex_runtime_destroy(struct obex_runtime *rt);
+
+int obex_runtime_add(struct obex_runtime *rt, struct obex *self);
+int obex_runtime_close(struct obex_runtime *rt, struct obex *self);
+
+#endif /* OBEX_RUNTIME_H */
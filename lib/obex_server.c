@@ -60,6 +60,7 @@ static result_t obex_server_abort_tx(obex_t *self)
 	if (self->object)
 		cmd = self->object->cmd;
 
+	obex_latency_request_end(self, self->abort_event == OBEX_EV_ABORT);
 	obex_deliver_event(self, self->abort_event, cmd, 0, true);
 	self->state = STATE_IDLE;
 
@@ -141,6 +142,7 @@ static result_t obex_server_response_tx(obex_t *self)
 			self->rsp_mode = OBEX_RSP_MODE_NORMAL;
 			self->srm_flags = 0;
 		}
+		obex_latency_request_end(self, true);
 		obex_deliver_event(self, OBEX_EV_REQDONE, cmd, 0, true);
 
 	} else if (self->object->rsp_mode == OBEX_RSP_MODE_SINGLE &&
@@ -173,6 +175,8 @@ static result_t obex_server_response_rx(obex_t *self)
 		return RESULT_SUCCESS;
 	}
 
+	obex_latency_packet_received(self);
+
 	/* Single response mode makes it possible for the client to send
 	 * the next request (e.g. PUT) while still receiving the last
 	 * multi-packet response. So we must not consume any request
@@ -215,6 +219,7 @@ static result_t obex_server_request_tx(obex_t *self)
 		self->substate = SUBSTATE_RX;
 
 	} else {
+		obex_latency_request_end(self, true);
 		obex_deliver_event(self, OBEX_EV_REQDONE, cmd, rsp, true);
 		self->state = STATE_IDLE;
 	}
@@ -256,6 +261,7 @@ static result_t obex_server_request_rx(obex_t *self, int first)
 
 	if (!obex_msg_rx_status(self))
 		return RESULT_SUCCESS;
+	obex_latency_packet_received(self);
 	cmd = msg_get_cmd(self);
 	final = msg_get_final(self);
 
@@ -387,7 +393,7 @@ static result_t obex_server_idle(obex_t *self)
 		return obex_server_abort_by_client(self);
 	}
 
-	self->object = obex_object_new();
+	self->object = obex_object_new(self->pool);
 	if (self->object == NULL) {
 		DEBUG(1, "Allocation of object failed!\n");
 		return RESULT_ERROR;
@@ -395,6 +401,8 @@ static result_t obex_server_idle(obex_t *self)
 	/* Remember the initial command of the request.*/
 	obex_object_setcmd(self->object, cmd);
 	self->object->rsp_mode = self->rsp_mode;
+	self->object->body_spill = self->body_spill;
+	obex_latency_request_start(self, cmd);
 
 	/* Hint app that something is about to come so that
 	 * the app can deny a PUT-like request early, or
@@ -426,6 +434,8 @@ static result_t obex_server_idle(obex_t *self)
 result_t obex_server(obex_t *self)
 {
 	DEBUG(4, "\n");
+	TRACE(self, OBEX_TRACE_STATE, self->state, self->substate);
+	PROBE4(state, self, self->mode, self->state, self->substate);
 
 	switch (self->state) {
 	case STATE_IDLE:
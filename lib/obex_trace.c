@@ -0,0 +1,180 @@
+/**
+ * @file obex_trace.c
+ *
+ * Binary trace of the events of a handle.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "obex_trace.h"
+#include "monotime.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The trace is a ring of fixed size entries that is only written by the
+ * thread that runs the handle. Nothing is formatted while tracing, an
+ * entry is a time stamp and three numbers.
+ *
+ * Readers do not lock out the writer. Every entry carries the sequence
+ * number it was written with, and an entry that changed while it was
+ * copied is dropped. */
+
+#if defined(__GNUC__)
+#define trace_load(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define trace_store(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define trace_fence()		__atomic_thread_fence(__ATOMIC_ACQ_REL)
+#else
+#define trace_load(p)		(*(volatile unsigned long *)(p))
+#define trace_store(p, v)	(*(p) = (v))
+#define trace_fence()		do { } while (0)
+#endif
+
+#define TRACE_MIN_SIZE	16
+#define TRACE_MAX_SIZE	(1 << 20)
+
+unsigned int obex_trace_size;
+
+struct obex_trace_slot {
+	obex_trace_t entry;
+	unsigned long seq;	/* 1 + number of the entry, 0 while written */
+};
+
+struct obex_trace {
+	unsigned long head;	/* number of entries written so far */
+	unsigned int mask;
+	unsigned int flags;
+	struct obex_trace_slot slots[1];
+};
+
+/** Create a trace
+ * @param size number of entries, rounded up to a power of two
+ * @param flags OBEX_TRACE_* flags
+ */
+struct obex_trace * obex_trace_create(unsigned int size, unsigned int flags)
+{
+	struct obex_trace *trace;
+	unsigned int n = TRACE_MIN_SIZE;
+
+	while (n < size && n < TRACE_MAX_SIZE)
+		n <<= 1;
+
+	trace = calloc(1, sizeof(*trace) +
+		       (n - 1) * sizeof(struct obex_trace_slot));
+	if (trace == NULL)
+		return NULL;
+
+	trace->mask = n - 1;
+	trace->flags = flags;
+	return trace;
+}
+
+void obex_trace_destroy(struct obex_trace *trace)
+{
+	free(trace);
+}
+
+unsigned int obex_trace_get_flags(const struct obex_trace *trace)
+{
+	return trace->flags;
+}
+
+void obex_trace_add(struct obex_trace *trace, enum obex_trace_type type,
+		    unsigned int code, int value)
+{
+	unsigned long n = trace->head;
+	struct obex_trace_slot *slot = &trace->slots[n & trace->mask];
+
+	trace_store(&slot->seq, 0UL);
+	trace_fence();
+	slot->entry.time = obex_monotime_ns();
+	slot->entry.type = (uint16_t)type;
+	slot->entry.code = (uint16_t)code;
+	slot->entry.value = value;
+	trace_store(&slot->seq, n + 1);
+	trace_store(&trace->head, n + 1);
+}
+
+/** Copy the newest entries, oldest first
+ * @return the number of copied entries
+ */
+unsigned int obex_trace_get(const struct obex_trace *trace,
+			    obex_trace_t *entries, unsigned int max)
+{
+	unsigned long head = trace_load(&trace->head);
+	unsigned long size = (unsigned long)trace->mask + 1;
+	unsigned long n = 0;
+	unsigned int count = 0;
+
+	if (head > size)
+		n = head - size;
+	if (head - n > max)
+		n = head - max;
+
+	for (; n != head; ++n) {
+		const struct obex_trace_slot *slot =
+					&trace->slots[n & trace->mask];
+
+		if (trace_load(&slot->seq) != n + 1)
+			continue;
+		entries[count] = slot->entry;
+		trace_fence();
+		if (trace_load(&slot->seq) == n + 1)
+			++count;
+	}
+
+	return count;
+}
+
+/* In the order of enum obex_trace_type */
+static const char *trace_type_names[] = {
+	"state",
+	"tx",
+	"rx",
+	"write",
+	"read",
+	"wait",
+	"event",
+};
+
+/** Write the trace to the debug log
+ * @param label printed in front of every line
+ */
+void obex_trace_dump(const struct obex_trace *trace, const char *label)
+{
+	unsigned int size = trace->mask + 1;
+	obex_trace_t *entries = malloc(size * sizeof(*entries));
+	unsigned int count, i;
+
+	if (entries == NULL)
+		return;
+
+	count = obex_trace_get(trace, entries, size);
+	for (i = 0; i < count; ++i) {
+		const obex_trace_t *e = &entries[i];
+		const char *name = "?";
+		int64_t rel = e->time - entries[count - 1].time;
+
+		if (e->type < sizeof(trace_type_names) /
+		    sizeof(*trace_type_names))
+			name = trace_type_names[e->type];
+
+		log_debug("%s%s: %+.6f %-5s %5u %d\n", log_debug_prefix,
+			  label, (double)rel / 1e9, name, e->code, e->value);
+	}
+
+	free(entries);
+}
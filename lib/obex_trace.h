@@ -0,0 +1,51 @@
+/**
+ * @file obex_trace.h
+ *
+ * Binary trace of the events of a handle.
+ * OpenOBEX library - Free implementation of the Object Exchange protocol.
+ *
+ * OpenOBEX is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef OBEX_TRACE_H
+#define OBEX_TRACE_H
+
+#include "obex_incl.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct obex_trace;
+
+/* Number of entries for new handles, from the OBEX_TRACE variable */
+extern unsigned int obex_trace_size;
+
+struct obex_trace * obex_trace_create(unsigned int size, unsigned int flags);
+void obex_trace_destroy(struct obex_trace *trace);
+unsigned int obex_trace_get_flags(const struct obex_trace *trace);
+
+void obex_trace_add(struct obex_trace *trace, enum obex_trace_type type,
+		    unsigned int code, int value);
+unsigned int obex_trace_get(const struct obex_trace *trace,
+			    obex_trace_t *entries, unsigned int max);
+void obex_trace_dump(const struct obex_trace *trace, const char *label);
+
+/* Only costs a test of the pointer while tracing is off */
+#define TRACE(self, type, code, value) \
+	do { \
+		if ((self)->trace) \
+			obex_trace_add((self)->trace, (type), (code), (value)); \
+	} while (0)
+
+#endif /* OBEX_TRACE_H */
@@ -35,6 +35,8 @@
 
 #if defined(_WIN32)
 #include <io.h>
+#else
+#include <poll.h>
 #endif
 
 #ifdef HAVE_IRDA
@@ -46,9 +48,13 @@
 #ifdef HAVE_USB
 #include "transport/usbobex.h"
 #endif /*HAVE_USB*/
+#ifdef HAVE_UNIX_SOCKET
+#include "transport/unixobex.h"
+#endif /*HAVE_UNIX_SOCKET*/
 #include "transport/inobex.h"
 #include "transport/customtrans.h"
 #include "transport/fdobex.h"
+#include "transport/loopobex.h"
 
 struct obex_transport * obex_transport_create(struct obex_transport_ops *ops)
 {
@@ -63,7 +69,10 @@ struct obex_transport * obex_transport_create(struct obex_transport_ops *ops)
 		trans->data = ops->create();
 
 	trans->timeout = -1; /* no time-out */
+	trans->revents = -1;
+	trans->backlog = 1;
 	trans->connected = false;
+	trans->in_input = false;
 	trans->server = false;
 
 	return trans;
@@ -106,6 +115,16 @@ bool obex_transport_init(obex_t *self, int transport)
 		break;
 #endif /*HAVE_USB*/
 
+	case OBEX_TRANS_LOOPBACK:
+		self->trans = loopobex_transport_create();
+		break;
+
+#ifdef HAVE_UNIX_SOCKET
+	case OBEX_TRANS_UNIX:
+		self->trans = unixobex_transport_create();
+		break;
+#endif /*HAVE_UNIX_SOCKET*/
+
 	default:
 		self->trans = NULL;
 		break;
@@ -183,6 +202,33 @@ void obex_transport_set_timeout(obex_t *self, int64_t timeout)
 	self->trans->timeout = timeout;
 }
 
+/*
+ * Function obex_transport_set_revents(self, revents)
+ *
+ *    Tell the transport which poll events the caller already saw on its
+ *    descriptor, so that it does not need to wait for them again.
+ *    Use -1 to forget them.
+ *
+ */
+void obex_transport_set_revents(obex_t *self, int revents)
+{
+	if (obex_transport_get_fd(self) == -1)
+		revents = -1;
+	self->trans->revents = revents;
+}
+
+/*
+ * Function obex_transport_set_backlog(self, backlog)
+ *
+ *    Change the length of the listen queue, 0 for the system maximum
+ *
+ */
+void obex_transport_set_backlog(obex_t *self, int backlog)
+{
+	DEBUG(4, "\n");
+	self->trans->backlog = backlog;
+}
+
 /*
  * Function obex_transport_handle_input(self)
  *
@@ -198,12 +244,87 @@ result_t obex_transport_handle_input(obex_t *self)
 		return RESULT_SUCCESS;
 	}
 
-	if (self->trans->ops->handle_input)
-		return self->trans->ops->handle_input(self);
-	else
+	/* The caller polled the descriptor already, so there is no need to
+	 * wait again. The events only count for the first read. */
+	if (self->trans->revents != -1) {
+		int revents = self->trans->revents;
+
+		self->trans->revents = 0;
+		if ((revents & (POLLIN | POLLERR | POLLHUP)) ||
+		    obex_transport_input_queued(self))
+			return RESULT_SUCCESS;
+		else
+			return RESULT_TIMEOUT;
+	}
+
+	if (self->trans->ops->handle_input) {
+		result_t ret;
+
+		self->trans->in_input = true;
+		ret = self->trans->ops->handle_input(self);
+		self->trans->in_input = false;
+		if (ret == RESULT_TIMEOUT)
+			++self->stats.timeouts;
+		TRACE(self, OBEX_TRACE_WAIT, 0, ret);
+		return ret;
+	} else
 		return RESULT_ERROR;
 }
 
+/*
+ * Function obex_transport_input_pending(self)
+ *
+ *    Check without waiting if the transport has more input. Events that
+ *    were reported by the caller are not used, they are already consumed.
+ *
+ */
+bool obex_transport_input_pending(obex_t *self)
+{
+	struct obex_transport *trans = self->trans;
+	int64_t timeout = trans->timeout;
+	result_t ret;
+
+	if (trans->ops->handle_input == NULL)
+		return false;
+
+	trans->timeout = 0;
+	trans->in_input = true;
+	ret = trans->ops->handle_input(self);
+	trans->in_input = false;
+	trans->timeout = timeout;
+
+	return (ret == RESULT_SUCCESS);
+}
+
+/*
+ * Function obex_transport_input_queued(self)
+ *
+ *    Check if the transport already received data that was not read yet.
+ *    Such data does not show up as poll events on the descriptor.
+ *
+ */
+bool obex_transport_input_queued(obex_t *self)
+{
+	struct obex_transport *trans = self->trans;
+
+	if (trans->ops->input_queued == NULL || !trans->connected)
+		return false;
+
+	return trans->ops->input_queued(self);
+}
+
+/*
+ * Function obex_transport_in_input(self)
+ *
+ *    Check if the transport is currently waiting for input. Custom
+ *    transports feed their data from there.
+ *
+ */
+bool obex_transport_in_input(obex_t *self)
+{
+	return self->trans->in_input;
+}
+
 /*
  * Function obex_transport_set_local_addr(self, addr, len)
  *
@@ -289,8 +410,23 @@ ssize_t obex_transport_write(obex_t *self, buf_t *msg)
 	if (!self->trans->connected)
 		return 0;
 
-	if (self->trans->ops->write)
-		return self->trans->ops->write(self, msg);
+	if (self->trans->ops->write) {
+		size_t len = buf_get_length(msg);
+		int64_t start = obex_latency_transport_start(self);
+		ssize_t ret = self->trans->ops->write(self, msg);
+
+		obex_latency_transport_end(self, start);
+		TRACE(self, OBEX_TRACE_WRITE, 0, (int)ret);
+		PROBE3(write, self, len, ret);
+		++self->stats.writes;
+		if (ret > 0)
+			self->stats.bytes_out += ret;
+		if (ret >= 0 && (size_t)ret < len)
+			++self->stats.partial_writes;
+		else if (ret > 0)
+			obex_latency_packet_sent(self);
+		return ret;
+	}
 
 	return -1;
 }
@@ -305,20 +441,32 @@ ssize_t obex_transport_read(obex_t *self, int max)
 {
 	struct databuffer *msg = self->rx_msg;
 	size_t msglen = buf_get_length(msg);
+	size_t room = self->mtu_rx;
 	void *buf;
 
 	if (!self->trans->connected)
 		return 0;
 
-	if (buf_set_size(msg, msglen + self->mtu_rx))
+	if ((size_t)max > room)
+		room = max;
+	if (buf_get_size(msg) < msglen + room &&
+	    buf_set_size(msg, msglen + room))
 		return -1;
 
 	buf = (uint8_t *)buf_get(msg) + msglen;
 
 	if (self->trans->ops->read) {
+		int64_t start = obex_latency_transport_start(self);
 		ssize_t ret = self->trans->ops->read(self, buf, max);
-		if (ret > 0)
+
+		obex_latency_transport_end(self, start);
+		TRACE(self, OBEX_TRACE_READ, max, (int)ret);
+		PROBE3(read, self, max, ret);
+		++self->stats.reads;
+		if (ret > 0) {
 			buf_append(msg, NULL, ret);
+			self->stats.bytes_in += ret;
+		}
 		return ret;
 	} else
 		return 0;
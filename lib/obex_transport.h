@@ -47,6 +47,7 @@ struct obex_transport_ops {
 	result_t (*handle_input)(obex_t*);
 	ssize_t (*write)(obex_t*, struct databuffer*);
 	ssize_t (*read)(obex_t*, void*, int);
+	bool (*input_queued)(obex_t*);
 	bool (*disconnect)(obex_t*);
 
 	int (*get_fd)(obex_t*);
@@ -73,7 +74,10 @@ typedef struct obex_transport {
 	void *data;		/* Private data for the transport */
 
 	int64_t timeout;	/* set timeout */
+	int revents;		/* poll events already known, or -1 */
+	int backlog;		/* length of the listen queue */
 	bool connected;		/* Link connection state */
+	bool in_input;		/* Inside of ops->handle_input */
 	bool server;		/* Listens on local interface */
 } obex_transport_t;
 
@@ -84,7 +88,12 @@ bool obex_transport_is_server(obex_t *self);
 bool obex_transport_accept(obex_t *self, const obex_t *server);
 int64_t obex_transport_get_timeout(struct obex *self);
 void obex_transport_set_timeout(struct obex *self, int64_t timeout);
+void obex_transport_set_revents(struct obex *self, int revents);
+void obex_transport_set_backlog(struct obex *self, int backlog);
 result_t obex_transport_handle_input(struct obex *self);
+bool obex_transport_input_pending(struct obex *self);
+bool obex_transport_input_queued(struct obex *self);
+bool obex_transport_in_input(struct obex *self);
 bool obex_transport_connect_request(struct obex *self);
 void obex_transport_disconnect(struct obex *self);
 bool obex_transport_listen(struct obex *self);
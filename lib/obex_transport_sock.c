@@ -22,6 +22,11 @@
 
 #ifdef _WIN32
 #include <winsock2.h>
+#else
+#include <sys/uio.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #endif /* _WIN32 */
 
 #include <stdlib.h>
@@ -40,9 +45,8 @@
 #define WSA_VER_MAJOR 2
 #define WSA_VER_MINOR 2
 #endif
-socket_t create_stream_socket(int domain, int proto, unsigned int flags)
+socket_t create_socket(int domain, int type, int proto, unsigned int flags)
 {
-	int type = SOCK_STREAM;
 	socket_t fd;
 
 	if (flags & OBEX_FL_CLOEXEC)
@@ -56,6 +60,11 @@ socket_t create_stream_socket(int domain, int proto, unsigned int flags)
 	return fd;
 }
 
+socket_t create_stream_socket(int domain, int proto, unsigned int flags)
+{
+	return create_socket(domain, SOCK_STREAM, proto, flags);
+}
+
 bool close_socket(socket_t fd)
 {
 	if (fd != INVALID_SOCKET) {
@@ -113,7 +122,8 @@ struct obex_sock * obex_transport_sock_create(int domain, int proto,
 					      unsigned int flags)
 {
 	struct obex_sock *sock = calloc(1, sizeof(*sock));
-#define SAVE_FLAGS (OBEX_FL_CLOEXEC | OBEX_FL_NONBLOCK | OBEX_FL_KEEPSERVER)
+#define SAVE_FLAGS (OBEX_FL_CLOEXEC | OBEX_FL_NONBLOCK | OBEX_FL_KEEPSERVER | \
+		    OBEX_FL_REUSEPORT)
 
 	DEBUG(4, "\n");
 
@@ -121,6 +131,7 @@ struct obex_sock * obex_transport_sock_create(int domain, int proto,
 		return NULL;
 
 	sock->domain = domain;
+	sock->type = SOCK_STREAM;
 	sock->proto = proto;
 	sock->addr_size = addr_size;
 	sock->flags = flags & SAVE_FLAGS;
@@ -179,6 +190,91 @@ bool obex_transport_sock_set_remote(struct obex_sock *sock,
 	return true;
 }
 
+#ifndef _WIN32
+/* Maximum number of buffer parts passed to one send call */
+#define SOCK_SEND_VEC_MAX 16
+
+/** Send file data directly from the file */
+static ssize_t sock_send_file(socket_t fd, struct databuffer *msg,
+			      const struct databuffer_vec *vec)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+	off_t offset = (off_t)vec->offset;
+	ssize_t status;
+
+	status = sendfile(fd, vec->fd, &offset, vec->len);
+	if (status != -1 || (errno != EINVAL && errno != ENOSYS))
+		return (status == 0)? -1: status;
+
+	DEBUG(3, "sendfile() not possible, falling back to send()\n");
+#endif
+	/* The buffer reads the file data when joining the parts */
+	if (buf_get(msg) == NULL)
+		return -1;
+	return send(fd, buf_get(msg), buf_get_length(msg), 0);
+}
+
+/** Send the buffer parts without joining them first
+ * Descriptors are passed along with memory data (SCM_RIGHTS). If the
+ * buffer starts with file data, that is sent alone and the descriptors
+ * wait for the memory data behind it.
+ */
+static ssize_t sock_send_vec(socket_t fd, struct databuffer *msg, bool more,
+			     const int *fds, unsigned int *nfds)
+{
+	struct databuffer_vec vec[SOCK_SEND_VEC_MAX];
+	struct iovec iov[SOCK_SEND_VEC_MAX];
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * OBEX_SOCK_MAX_FDS)];
+	} control;
+	struct msghdr mh;
+	int flags = 0;
+	int i, n;
+
+	if (*nfds > OBEX_SOCK_MAX_FDS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = buf_get_vec(msg, vec, SOCK_SEND_VEC_MAX);
+	if (n > 0 && vec[0].base == NULL) {
+		*nfds = 0;
+		return sock_send_file(fd, msg, &vec[0]);
+	}
+
+	/* Stop in front of file data, it is sent by the next call */
+	for (i = 0; i < n && vec[i].base; ++i) {
+		iov[i].iov_base = (void *)vec[i].base;
+		iov[i].iov_len = vec[i].len;
+	}
+#ifdef MSG_MORE
+	if (more)
+		flags |= MSG_MORE;
+#endif
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = i;
+
+	if (*nfds) {
+		struct cmsghdr *cmsg;
+
+		memset(&control, 0, sizeof(control));
+		mh.msg_control = control.buf;
+		mh.msg_controllen = CMSG_SPACE(sizeof(int) * *nfds);
+
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * *nfds);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * *nfds);
+	}
+
+	return sendmsg(fd, &mh, flags);
+}
+#endif /* _WIN32 */
+
 /** Send a buffer.
  * It may happen (especially with non-blocking mode) that the buffer is only
  * sent partially.
@@ -186,38 +282,71 @@ bool obex_transport_sock_set_remote(struct obex_sock *sock,
  * @param sock the socket instance
  * @param msg the message to send
  * @param timeout give up after timeout (in milliseconds)
+ * @param more more data follows right away, so partial segments may be
+ *        held back (if supported)
  * @return -1 on error, else number of sent bytes
  */
 ssize_t obex_transport_sock_send(struct obex_sock *sock, struct databuffer *msg,
-				 int64_t timeout)
+				 int64_t timeout, bool more)
+{
+	unsigned int nfds = 0;
+
+	return obex_transport_sock_send_fds(sock, msg, timeout, more, NULL,
+					    &nfds);
+}
+
+/** Send a buffer and pass file descriptors along with it.
+ * The descriptors are only passed if data was sent, i.e. the return value
+ * is positive, and not if only file data was sent.
+ *
+ * @param fds descriptors to pass (AF_UNIX only)
+ * @param nfds number of descriptors, up to OBEX_SOCK_MAX_FDS, returns the
+ *        number of passed descriptors
+ * @see obex_transport_sock_send()
+ */
+ssize_t obex_transport_sock_send_fds(struct obex_sock *sock,
+				     struct databuffer *msg, int64_t timeout,
+				     bool more, const int *fds,
+				     unsigned int *nfds)
 {
 	size_t size = buf_get_length(msg);
 	socket_t fd = sock->fd;
+	unsigned int count = *nfds;
 	ssize_t status;
 	fd_set fdset;
 
+	*nfds = 0;
 	if (size == 0)
 		return 0;
 
 	DEBUG(1, "sending %lu bytes\n", (unsigned long)size);
 
-	FD_ZERO(&fdset);
-	FD_SET(fd, &fdset);
-	if (timeout >= 0) {
-		struct timeval time = {(long)(timeout / 1000), (long)(timeout % 1000)};
-		status = select((int)fd + 1, NULL, &fdset, NULL, &time);
+	/* A non-blocking socket that may not wait at all does not need to
+	 * be polled, the send call reports if there is no room. */
+	if (timeout == 0 && (sock->flags & OBEX_FL_NONBLOCK)) {
+		status = 1;
 	} else {
-		status = select((int)fd + 1, NULL, &fdset, NULL, NULL);
+		FD_ZERO(&fdset);
+		FD_SET(fd, &fdset);
+		if (timeout >= 0) {
+			struct timeval time = {(long)(timeout / 1000), (long)(timeout % 1000)};
+			status = select((int)fd + 1, NULL, &fdset, NULL, &time);
+		} else {
+			status = select((int)fd + 1, NULL, &fdset, NULL, NULL);
+		}
 	}
 	if (status == 0)
 		return 0;
 
 	/* call send() if no error */
 	else if (status > 0)
+#if defined(_WIN32)
 		status = send(fd, buf_get(msg), size, 0);
+#else
+		status = sock_send_vec(fd, msg, more, fds, &count);
+#endif
 
 	/* The following are not really transport errors. */
-	else
 #if defined(_WIN32)
 	if (status == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
 		status = 0;
@@ -227,6 +356,8 @@ ssize_t obex_transport_sock_send(struct obex_sock *sock, struct databuffer *msg,
 		status = 0;
 #endif
 
+	if (status > 0)
+		*nfds = count;
 	return status;
 }
 
@@ -239,8 +370,8 @@ bool obex_transport_sock_connect(struct obex_sock *sock)
 	DEBUG(4, "\n");
 
 	if (fd == INVALID_SOCKET) {
-		fd = sock->fd = create_stream_socket(sock->domain, sock->proto,
-						     sock->flags);
+		fd = sock->fd = create_socket(sock->domain, sock->type,
+					       sock->proto, sock->flags);
 		if (fd == INVALID_SOCKET) {
 			DEBUG(4, "No valid socket: %d\n", errno);
 			goto err;
@@ -282,13 +413,13 @@ err:
 	return false;
 }
 
-bool obex_transport_sock_listen(struct obex_sock *sock)
+bool obex_transport_sock_listen(struct obex_sock *sock, int backlog)
 {
 	socket_t fd = sock->fd;
 	
 	if (fd == INVALID_SOCKET) {
-		fd = sock->fd = create_stream_socket(sock->domain, sock->proto,
-						     sock->flags);
+		fd = sock->fd = create_socket(sock->domain, sock->type,
+					       sock->proto, sock->flags);
 		if (fd == INVALID_SOCKET) {
 			DEBUG(4, "No valid socket: %d\n", errno);
 			goto err;
@@ -301,12 +432,30 @@ bool obex_transport_sock_listen(struct obex_sock *sock)
 			goto err;
 		}
 
+	if (sock->flags & OBEX_FL_REUSEPORT) {
+#ifdef SO_REUSEPORT
+		int on = 1;
+
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *)&on,
+			       sizeof(on)) == -1) {
+			DEBUG(0, "Error setting SO_REUSEPORT: %d\n", errno);
+			goto err;
+		}
+#else
+		DEBUG(0, "SO_REUSEPORT is not supported\n");
+		goto err;
+#endif
+	}
+
 	if (bind(fd, (struct sockaddr *)&sock->local, sock->addr_size) == -1) {
 		DEBUG(0, "Error doing bind\n");
 		goto err;
 	}
 
-	if (listen(fd, 1) == -1) {
+	if (backlog <= 0)
+		backlog = SOMAXCONN;
+
+	if (listen(fd, backlog) == -1) {
 		DEBUG(0, "Error doing listen\n");
 		goto err;
 	}
@@ -341,6 +490,9 @@ struct obex_sock * obex_transport_sock_accept(struct obex_sock *sock)
 		return NULL;
 
 	client->fd = INVALID_SOCKET;
+	client->domain = sock->domain;
+	client->type = sock->type;
+	client->proto = sock->proto;
 	client->addr_size = sock->addr_size;
 	client->flags = sock->flags;
 	addr = (struct sockaddr *) &client->remote;
@@ -422,13 +574,17 @@ result_t obex_transport_sock_wait(struct obex_sock *sock, int64_t timeout)
  * @param sock the socket instance
  * @param buf the buffer to receive into
  * @param buflen the maximum size to receive
- * @return -1 on error, else number of received bytes
+ * @return -1 on error or end of stream, else number of received bytes
  */
 ssize_t obex_transport_sock_recv(struct obex_sock *sock, void *buf, int buflen)
 {
 	socket_t fd = sock->fd;
 	ssize_t status = recv(fd, buf, buflen, 0);
 
+	/* The peer closed the connection, nothing will arrive anymore */
+	if (status == 0 && buflen > 0)
+		return -1;
+
 	/* The following are not really transport errors. */
 #if defined(_WIN32)
 	if (status == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
@@ -441,3 +597,89 @@ ssize_t obex_transport_sock_recv(struct obex_sock *sock, void *buf, int buflen)
 
 	return status;
 }
+
+#ifndef _WIN32
+/** Receive into a buffer and take descriptors passed along with the data
+ * Received descriptors that do not fit are closed. On a SOCK_SEQPACKET
+ * socket, a record that does not fit into the buffer is an error.
+ *
+ * @param fds array to store received descriptors to
+ * @param nfds size of fds, returns the number of received descriptors
+ * @see obex_transport_sock_recv()
+ */
+ssize_t obex_transport_sock_recv_fds(struct obex_sock *sock, void *buf,
+				     int buflen, int *fds, unsigned int *nfds)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * OBEX_SOCK_MAX_FDS)];
+	} control;
+	unsigned int max = *nfds;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct msghdr mh;
+	int flags = 0;
+	ssize_t status;
+
+	*nfds = 0;
+
+	iov.iov_base = buf;
+	iov.iov_len = buflen;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = control.buf;
+	mh.msg_controllen = sizeof(control.buf);
+
+#ifdef MSG_CMSG_CLOEXEC
+	if (sock->flags & OBEX_FL_CLOEXEC)
+		flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+	status = recvmsg(sock->fd, &mh, flags);
+	if (status == -1) {
+		if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&mh, cmsg))
+	{
+		const int *data = (const int *)CMSG_DATA(cmsg);
+		size_t i, count;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < count; ++i) {
+			int fd;
+
+			memcpy(&fd, data + i, sizeof(fd));
+			if (*nfds < max) {
+				fds[(*nfds)++] = fd;
+			} else {
+				DEBUG(1, "Dropping passed descriptor\n");
+				(void)close(fd);
+			}
+		}
+	}
+
+	if (mh.msg_flags & MSG_CTRUNC)
+		DEBUG(1, "Passed descriptors were truncated\n");
+
+	if (mh.msg_flags & MSG_TRUNC) {
+		DEBUG(0, "Received record does not fit into %d bytes\n",
+		      buflen);
+		return -1;
+	}
+
+	/* The peer closed the connection, nothing will arrive anymore */
+	if (status == 0 && buflen > 0)
+		return -1;
+
+	return status;
+}
+#endif /* _WIN32 */
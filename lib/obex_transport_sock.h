@@ -35,10 +35,15 @@
 
 #include "defines.h"
 
+/** maximum number of descriptors passed with one send call */
+#define OBEX_SOCK_MAX_FDS 8
+
 /** a socket instance */
 struct obex_sock {
 	/** socket domain */
 	int domain;
+	/** socket type (SOCK_STREAM or SOCK_SEQPACKET) */
+	int type;
 	/** socket protocol */
 	int proto;
 	/** the kernel descriptor for this socket */
@@ -58,6 +63,7 @@ struct obex_sock {
 bool obex_transport_sock_init(void);
 void obex_transport_sock_cleanup(void);
 
+socket_t create_socket(int domain, int type, int proto, unsigned int flags);
 socket_t create_stream_socket(int domain, int proto, unsigned int flags);
 bool close_socket(socket_t fd);
 
@@ -73,14 +79,22 @@ bool obex_transport_sock_set_remote(struct obex_sock *sock,
 				    const struct sockaddr *addr, socklen_t len);
 
 bool obex_transport_sock_connect(struct obex_sock *sock);
-bool obex_transport_sock_listen(struct obex_sock *sock);
+bool obex_transport_sock_listen(struct obex_sock *sock, int backlog);
 struct obex_sock * obex_transport_sock_accept(struct obex_sock *sock);
 bool obex_transport_sock_disconnect(struct obex_sock *sock);
 
 ssize_t obex_transport_sock_send(struct obex_sock *sock, struct databuffer *msg,
-				 int64_t timeout);
+				 int64_t timeout, bool more);
+ssize_t obex_transport_sock_send_fds(struct obex_sock *sock,
+				     struct databuffer *msg, int64_t timeout,
+				     bool more, const int *fds,
+				     unsigned int *nfds);
 result_t obex_transport_sock_wait(struct obex_sock *sock, int64_t timeout);
 ssize_t obex_transport_sock_recv(struct obex_sock *sock, void *buf, int buflen);
+#ifndef _WIN32
+ssize_t obex_transport_sock_recv_fds(struct obex_sock *sock, void *buf,
+				     int buflen, int *fds, unsigned int *nfds);
+#endif
 
 result_t obex_transport_sock_handle_input(struct obex_sock *sock, obex_t *self);
 
@@ -0,0 +1,194 @@
+/**
+	\file ringbuf.c
+	Receive buffer handling routines.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "ringbuf.h"
+#include "databuffer.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* Consuming data from the front only moves the start of the data, so
+ * clearing a message does not depend on how much data follows it. The
+ * content must stay contiguous for the message parsers, so instead of
+ * wrapping around byte-wise, the remaining data is moved back to the
+ * front of the memory once when the end is reached. That is at most the
+ * part of a message that was not consumed yet. */
+
+struct ringbuf_data {
+	uint8_t *buffer;
+	size_t buffer_size;
+
+	size_t start;
+	size_t data_len;
+};
+
+/** Move the data to the front of the memory */
+static void ringbuf_rewind(struct ringbuf_data *p) {
+	if (p->start == 0)
+		return;
+
+	if (p->data_len) {
+		DEBUG(4, "Moving %lu bytes to the front\n",
+		      (unsigned long)p->data_len);
+		memmove(p->buffer, p->buffer + p->start, p->data_len);
+	}
+	p->start = 0;
+}
+
+static int ringbuf_set_size(void *self, size_t new_size) {
+	struct ringbuf_data *p = self;
+	uint8_t *tmp;
+
+	if (new_size < p->data_len)
+		new_size = p->data_len;
+
+	/* There is enough memory if the data starts at the front */
+	if (new_size <= p->buffer_size && new_size > p->buffer_size - p->start)
+		ringbuf_rewind(p);
+	if (new_size <= p->buffer_size)
+		return 0;
+
+	ringbuf_rewind(p);
+	tmp = realloc(p->buffer, new_size);
+	if (!tmp)
+		return -errno;
+
+	p->buffer = tmp;
+	p->buffer_size = new_size;
+	return 0;
+}
+
+static void *ringbuf_new(size_t default_size) {
+	struct ringbuf_data *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+
+	if (ringbuf_set_size(p, default_size) < 0) {
+		free(p);
+		p = NULL;
+	}
+
+	return (void*)p;
+}
+
+static void ringbuf_delete(void *self) {
+	struct ringbuf_data *p = self;
+
+	if (!p)
+		return;
+	free(p->buffer);
+	free(p);
+}
+
+/* The size is counted from the start of the data, so that writing behind
+ * the data (like the transport does) stays within the memory. */
+static size_t ringbuf_get_size(void *self) {
+	struct ringbuf_data *p = self;
+
+	if (!p)
+		return 0;
+	else
+		return p->buffer_size - p->start;
+}
+
+static size_t ringbuf_get_length(const void *self) {
+	const struct ringbuf_data *p = self;
+
+	if (!p)
+		return 0;
+	else
+		return p->data_len;
+}
+
+static void* ringbuf_get(const void *self) {
+	const struct ringbuf_data *p = self;
+
+	if (!p || !p->buffer)
+		return NULL;
+	else
+		return p->buffer + p->start;
+}
+
+static void ringbuf_clear(void *self, size_t len) {
+	struct ringbuf_data *p = self;
+
+	if (!p || !p->data_len)
+		return;
+
+	if (len >= p->data_len) {
+		p->start = 0;
+		p->data_len = 0;
+	} else {
+		p->start += len;
+		p->data_len -= len;
+	}
+}
+
+/** Append data, with data == NULL the bytes are taken as they are in
+ * memory (e.g. after reading directly into the buffer) */
+static int ringbuf_append(void *self, const void *data, size_t len) {
+	struct ringbuf_data *p = self;
+
+	if (!p)
+		return -EINVAL;
+
+	DEBUG(4, "Request to append %lu bytes\n", (unsigned long)len);
+	if (len > p->buffer_size - (p->start + p->data_len)) {
+		size_t new_size = p->data_len + len;
+		int ret;
+
+		if (new_size > p->buffer_size && new_size < 2 * p->buffer_size)
+			new_size = 2 * p->buffer_size;
+		ret = ringbuf_set_size(p, new_size);
+		if (ret < 0) {
+			DEBUG(4, "Resizing failed\n");
+			return ret;
+		}
+	}
+
+	if (data)
+		memcpy(p->buffer + p->start + p->data_len, data, len);
+	p->data_len += len;
+	return 0;
+}
+
+static struct databuffer_ops ringbuf_ops = {
+	&ringbuf_new,
+	&ringbuf_delete,
+	NULL,
+	NULL,
+	&ringbuf_get_size,
+	&ringbuf_set_size,
+	&ringbuf_get_length,
+	&ringbuf_get,
+	&ringbuf_clear,
+	&ringbuf_append,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+};
+
+struct databuffer *ringbuf_create(size_t default_size) {
+	return buf_create(default_size, &ringbuf_ops);
+}
@@ -0,0 +1,317 @@
+/**
+	\file spillbuf.c
+	Buffer that moves large content to a temporary file.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#include "spillbuf.h"
+#include "databuffer.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/* The buffer lives on the heap until it needs to be larger than the
+ * threshold. Then the content moves to a shared mapping of an unlinked
+ * temporary file. The kernel can write such pages back to the disk and
+ * drop them, so many large bodies do not all have to fit into memory.
+ * The content stays contiguous either way, so readers do not see the
+ * difference.
+ *
+ * Without mmap() (Windows) or without a usable temporary directory the
+ * buffer stays on the heap. */
+
+struct spillbuf_data {
+	uint8_t *buffer;
+	size_t buffer_size;
+	size_t data_len;
+
+	size_t threshold;	/* 0 to never spill */
+	int fd;			/* temporary file or -1 while on the heap */
+};
+
+#ifndef _WIN32
+static int spillbuf_tmpfile(void)
+{
+	const char *dir = getenv("TMPDIR");
+	char *path;
+	int fd;
+
+	if (dir == NULL || dir[0] == '\0')
+		dir = "/tmp";
+
+#if defined(O_TMPFILE)
+	fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (fd >= 0)
+		return fd;
+#endif
+
+	path = malloc(strlen(dir) + sizeof("/openobex-XXXXXX"));
+	if (path == NULL)
+		return -1;
+
+	strcpy(path, dir);
+	strcat(path, "/openobex-XXXXXX");
+	fd = mkstemp(path);
+	if (fd >= 0) {
+		unlink(path);
+		(void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	free(path);
+	return fd;
+}
+
+/** Resize the file and reserve its blocks
+ * The pages of a shared mapping must be backed by the file, a store to a
+ * page without blocks raises SIGBUS when the file system is full. Only
+ * where blocks cannot be reserved, the file is just made larger.
+ */
+static int spillbuf_resize(int fd, size_t old_size, size_t new_size)
+{
+#if defined(HAVE_POSIX_FALLOCATE)
+	if (new_size > old_size) {
+		int err = posix_fallocate(fd, (off_t)old_size,
+					  (off_t)(new_size - old_size));
+		if (err == 0)
+			return 0;
+		if (err != EINVAL && err != EOPNOTSUPP) {
+			/* Drop what was reserved before running out */
+			(void)ftruncate(fd, (off_t)old_size);
+			return -err;
+		}
+	}
+#endif
+	if (ftruncate(fd, (off_t)new_size) < 0)
+		return -errno;
+	return 0;
+}
+
+/** Resize the file and its mapping */
+static int spillbuf_map(struct spillbuf_data *p, size_t new_size)
+{
+	size_t old_size = p->buffer? p->buffer_size: 0;
+	void *tmp;
+	int ret;
+
+	ret = spillbuf_resize(p->fd, old_size, new_size);
+	if (ret < 0)
+		return ret;
+
+	if (p->buffer == NULL)
+		tmp = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   p->fd, 0);
+	else {
+#if defined(MREMAP_MAYMOVE)
+		tmp = mremap(p->buffer, p->buffer_size, new_size,
+			     MREMAP_MAYMOVE);
+#else
+		munmap(p->buffer, p->buffer_size);
+		p->buffer = NULL;
+		tmp = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   p->fd, 0);
+#endif
+	}
+	if (tmp == MAP_FAILED)
+		return -errno;
+
+	p->buffer = tmp;
+	p->buffer_size = new_size;
+	return 0;
+}
+
+/** Move the content from the heap to a temporary file */
+static int spillbuf_spill(struct spillbuf_data *p, size_t new_size)
+{
+	uint8_t *heap = p->buffer;
+	size_t heap_size = p->buffer_size;
+	int ret;
+
+	p->fd = spillbuf_tmpfile();
+	if (p->fd < 0)
+		return -errno;
+
+	p->buffer = NULL;
+	ret = spillbuf_map(p, new_size);
+	if (ret < 0) {
+		close(p->fd);
+		p->fd = -1;
+		p->buffer = heap;
+		p->buffer_size = heap_size;
+		return ret;
+	}
+
+	DEBUG(3, "Spilled %lu bytes to a file of %lu bytes\n",
+	      (unsigned long)p->data_len, (unsigned long)new_size);
+	if (p->data_len)
+		memcpy(p->buffer, heap, p->data_len);
+	free(heap);
+	return 0;
+}
+#endif /* _WIN32 */
+
+static int spillbuf_set_size(void *self, size_t new_size) {
+	struct spillbuf_data *p = self;
+	uint8_t *tmp;
+
+	if (new_size < p->data_len)
+		new_size = p->data_len;
+	if (new_size == p->buffer_size || new_size == 0)
+		return 0;
+
+#ifndef _WIN32
+	if (p->fd >= 0)
+		return spillbuf_map(p, new_size);
+
+	if (p->threshold && new_size > p->threshold &&
+	    spillbuf_spill(p, new_size) == 0)
+		return 0;
+#endif
+
+	tmp = realloc(p->buffer, new_size);
+	if (!tmp)
+		return -errno;
+
+	p->buffer = tmp;
+	p->buffer_size = new_size;
+	return 0;
+}
+
+static void *spillbuf_new(size_t default_size) {
+	struct spillbuf_data *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+
+	p->fd = -1;
+	if (spillbuf_set_size(p, default_size) < 0) {
+		free(p);
+		p = NULL;
+	}
+
+	return (void*)p;
+}
+
+static void spillbuf_delete(void *self) {
+	struct spillbuf_data *p = self;
+
+	if (!p)
+		return;
+
+#ifndef _WIN32
+	if (p->fd >= 0) {
+		munmap(p->buffer, p->buffer_size);
+		close(p->fd);
+	} else
+#endif
+		free(p->buffer);
+	free(p);
+}
+
+static size_t spillbuf_get_size(void *self) {
+	struct spillbuf_data *p = self;
+
+	return p->buffer_size;
+}
+
+static size_t spillbuf_get_length(const void *self) {
+	const struct spillbuf_data *p = self;
+
+	return p->data_len;
+}
+
+static void *spillbuf_get(const void *self) {
+	const struct spillbuf_data *p = self;
+
+	return p->buffer;
+}
+
+static void spillbuf_clear(void *self, size_t len) {
+	struct spillbuf_data *p = self;
+
+	if (len > p->data_len)
+		len = p->data_len;
+	if (len < p->data_len)
+		memmove(p->buffer, p->buffer + len, p->data_len - len);
+	p->data_len -= len;
+}
+
+static int spillbuf_append(void *self, const void *data, size_t len) {
+	struct spillbuf_data *p = self;
+
+	/* Grow by half the size so that bodies without a length hint are
+	 * not copied once per packet */
+	if (len > p->buffer_size - p->data_len) {
+		size_t new_size = p->buffer_size + p->buffer_size / 2;
+		int ret;
+
+		if (new_size < p->data_len + len)
+			new_size = p->data_len + len;
+		ret = spillbuf_set_size(self, new_size);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (data)
+		memcpy(p->buffer + p->data_len, data, len);
+	p->data_len += len;
+	return 0;
+}
+
+static struct databuffer_ops spillbuf_ops = {
+	&spillbuf_new,
+	&spillbuf_delete,
+	NULL,
+	NULL,
+	&spillbuf_get_size,
+	&spillbuf_set_size,
+	&spillbuf_get_length,
+	&spillbuf_get,
+	&spillbuf_clear,
+	&spillbuf_append,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/** Create a buffer that moves to a temporary file above a size
+ * @param default_size initial size
+ * @param threshold largest size on the heap, 0 to always stay there
+ */
+struct databuffer *spillbuf_create(size_t default_size, size_t threshold) {
+	struct databuffer *buf = buf_create(0, &spillbuf_ops);
+	struct spillbuf_data *p;
+
+	if (!buf)
+		return NULL;
+
+	p = buf->ops_data;
+	p->threshold = threshold;
+	if (spillbuf_set_size(p, default_size) < 0) {
+		buf_delete(buf);
+		return NULL;
+	}
+
+	return buf;
+}
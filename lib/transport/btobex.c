@@ -154,7 +154,7 @@ static bool btobex_listen(obex_t *self)
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_listen(data->sock);
+	return obex_transport_sock_listen(data->sock, self->trans->backlog);
 }
 
 /*
@@ -226,7 +226,7 @@ static ssize_t btobex_write(obex_t *self, struct databuffer *msg)
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_send(data->sock, msg, trans->timeout);
+	return obex_transport_sock_send(data->sock, msg, trans->timeout, false);
 }
 
 static ssize_t btobex_read(obex_t *self, void *buf, int buflen)
@@ -253,6 +253,7 @@ static struct obex_transport_ops btobex_transport_ops = {
 	&btobex_handle_input,
 	&btobex_write,
 	&btobex_read,
+	NULL,
 	&btobex_disconnect,
 
 	&btobex_get_fd,
@@ -33,7 +33,14 @@
 #include <io.h>
 #define fd_t unsigned int
 #else
+#include <sys/uio.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #define fd_t int
+
+/* Maximum number of buffer parts passed to one write call */
+#define FDOBEX_WRITE_VEC_MAX 16
 #endif
 
 struct fdobex_data {
@@ -89,6 +96,28 @@ static bool fdobex_disconnect(obex_t *self)
 	return fdobex_init(self);
 }
 
+#if !defined(_WIN32)
+/** Write file data directly from the file */
+static ssize_t fdobex_write_file(fd_t fd, struct databuffer *msg,
+				 const struct databuffer_vec *vec)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+	off_t offset = (off_t)vec->offset;
+	ssize_t status;
+
+	status = sendfile(fd, vec->fd, &offset, vec->len);
+	if (status != -1 || (errno != EINVAL && errno != ENOSYS))
+		return (status == 0)? -1: status;
+
+	DEBUG(3, "sendfile() not possible, falling back to write()\n");
+#endif
+	/* The buffer reads the file data when joining the parts */
+	if (buf_get(msg) == NULL)
+		return -1;
+	return write(fd, buf_get(msg), buf_get_length(msg));
+}
+#endif
+
 static ssize_t fdobex_write(obex_t *self, buf_t *msg)
 {
 	struct obex_transport *trans = self->trans;
@@ -117,7 +146,23 @@ static ssize_t fdobex_write(obex_t *self, buf_t *msg)
 #if defined(_WIN32)
 	status = _write(fd, buf_get(msg), size);
 #else
-	status = write(fd, buf_get(msg), size);
+	{
+		struct databuffer_vec vec[FDOBEX_WRITE_VEC_MAX];
+		struct iovec iov[FDOBEX_WRITE_VEC_MAX];
+		int i, n;
+
+		n = buf_get_vec(msg, vec, FDOBEX_WRITE_VEC_MAX);
+		if (n > 0 && vec[0].base == NULL)
+			status = fdobex_write_file(fd, msg, &vec[0]);
+		else {
+			/* Stop in front of file data */
+			for (i = 0; i < n && vec[i].base; ++i) {
+				iov[i].iov_base = (void *)vec[i].base;
+				iov[i].iov_len = vec[i].len;
+			}
+			status = writev(fd, iov, i);
+		}
+	}
 	/* The following are not really transport errors. */
 	if (status == -1 &&
 	    (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
@@ -163,6 +208,9 @@ static ssize_t fdobex_read(obex_t *self, void *buf, int buflen)
 	status = _read(fd, buf, buflen);
 #else
 	status = read(fd, buf, buflen);
+	/* End of file, nothing will arrive anymore */
+	if (status == 0 && buflen > 0)
+		return -1;
 	/* The following are not really transport errors */
 	if (status == -1 &&
 	    (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
@@ -187,6 +235,7 @@ static struct obex_transport_ops fdobex_transport_ops = {
 	&fdobex_handle_input,
 	&fdobex_write,
 	&fdobex_read,
+	NULL,
 	&fdobex_disconnect,
 
 	&fdobex_get_fd,
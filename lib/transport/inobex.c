@@ -32,6 +32,7 @@
 #include <netinet/in.h>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #endif /*_WIN32*/
 
@@ -44,11 +45,16 @@
 #include <stdlib.h>
 
 #include "obex_transport_sock.h"
+#include "databuffer.h"
 #include "cloexec.h"
 #include "nonblock.h"
 
+/* Number of buffer parts that are checked for file data */
+#define INOBEX_SEND_VEC 16
+
 struct inobex_data {
 	struct obex_sock *sock;
+	unsigned int send_policy;	/* OBEX_TCP_* flags */
 };
 
 #if 0
@@ -112,7 +118,40 @@ static void map_ip4to6(struct sockaddr_in *in, struct sockaddr_in6 *out)
 
 static void * inobex_create(void)
 {
-	return calloc(1, sizeof(struct inobex_data));
+	struct inobex_data *data = calloc(1, sizeof(*data));
+
+	if (data)
+		data->send_policy = OBEX_TCP_DEFAULT;
+	return data;
+}
+
+/** Apply the socket options of the send policy to a connected socket */
+static void inobex_apply_send_policy(struct inobex_data *data)
+{
+	socket_t fd = obex_transport_sock_get_fd(data->sock);
+	int nodelay = !!(data->send_policy & OBEX_TCP_NODELAY);
+
+	if (fd == INVALID_SOCKET)
+		return;
+
+	/* Errors do not matter, the data just gets sent differently */
+	(void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *)&nodelay,
+			 sizeof(nodelay));
+}
+
+/*
+ * Function inobex_set_send_policy (self, policy)
+ *
+ *    Change how packets are handed to TCP
+ *
+ */
+void inobex_set_send_policy(obex_t *self, unsigned int policy)
+{
+	struct inobex_data *data = self->trans->data;
+
+	data->send_policy = policy;
+	if (self->trans->connected)
+		inobex_apply_send_policy(data);
 }
 
 static bool inobex_init (obex_t *self)
@@ -272,7 +311,7 @@ static bool inobex_listen(obex_t *self)
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_listen(data->sock);
+	return obex_transport_sock_listen(data->sock, self->trans->backlog);
 }
 
 /*
@@ -295,6 +334,8 @@ static bool inobex_accept(obex_t *self, const obex_t *server)
 	if (data->sock == NULL)
 		return false;
 
+	data->send_policy = server_data->send_policy;
+	inobex_apply_send_policy(data);
 	return true;
 }
 
@@ -307,7 +348,11 @@ static bool inobex_connect_request(obex_t *self)
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_connect(data->sock);
+	if (!obex_transport_sock_connect(data->sock))
+		return false;
+
+	inobex_apply_send_policy(data);
+	return true;
 }
 
 /*
@@ -334,14 +379,35 @@ static result_t inobex_handle_input(obex_t *self)
 	return obex_transport_sock_wait(data->sock, self->trans->timeout);
 }
 
+/** Check if file data follows the memory data at the start of msg
+ * The file data is sent by a later call.
+ */
+static bool inobex_file_follows(struct databuffer *msg)
+{
+	struct databuffer_vec vec[INOBEX_SEND_VEC];
+	int i, n;
+
+	n = buf_get_vec(msg, vec, INOBEX_SEND_VEC);
+	if (n <= 0 || vec[0].base == NULL)
+		return false;
+
+	for (i = 1; i < n; ++i) {
+		if (vec[i].base == NULL)
+			return true;
+	}
+	return false;
+}
+
 static ssize_t inobex_write(obex_t *self, struct databuffer *msg)
 {
 	struct obex_transport *trans = self->trans;
 	struct inobex_data *data = self->trans->data;
+	bool more = (data->send_policy & OBEX_TCP_MORE) &&
+		(self->tx_more || inobex_file_follows(msg));
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_send(data->sock, msg, trans->timeout);
+	return obex_transport_sock_send(data->sock, msg, trans->timeout, more);
 }
 
 static ssize_t inobex_read(obex_t *self, void *buf, int buflen)
@@ -368,6 +434,7 @@ static struct obex_transport_ops inobex_transport_ops = {
 	&inobex_handle_input,
 	&inobex_write,
 	&inobex_read,
+	NULL,
 	&inobex_disconnect,
 
 	&inobex_get_fd,
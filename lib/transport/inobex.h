@@ -24,4 +24,5 @@
 struct obex_transport * inobex_transport_create(void);
 void inobex_prepare_connect(obex_t *self, struct sockaddr *saddr, int addrlen);
 void inobex_prepare_listen(obex_t *self, struct sockaddr *saddr, int addrlen);
+void inobex_set_send_policy(obex_t *self, unsigned int policy);
 #endif
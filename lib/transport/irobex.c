@@ -303,7 +303,7 @@ static bool irobex_listen(obex_t *self)
 
 	data->sock->set_sock_opts = &set_listen_sock_opts;
 
-	return obex_transport_sock_listen(data->sock);
+	return obex_transport_sock_listen(data->sock, self->trans->backlog);
 }
 
 /*
@@ -503,7 +503,7 @@ static ssize_t irobex_write(obex_t *self, struct databuffer *msg)
 
 	DEBUG(4, "\n");
 
-	return obex_transport_sock_send(data->sock, msg, trans->timeout);
+	return obex_transport_sock_send(data->sock, msg, trans->timeout, false);
 }
 
 static ssize_t irobex_read(obex_t *self, void *buf, int buflen)
@@ -530,6 +530,7 @@ static struct obex_transport_ops irobex_transport_ops = {
 	&irobex_handle_input,
 	&irobex_write,
 	&irobex_read,
+	NULL,
 	&irobex_disconnect,
 
 	&irobex_get_fd,
@@ -0,0 +1,459 @@
+/**
+	\file loopobex.c
+	LoopOBEX, in-process loopback transport for OBEX.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "obex_main.h"
+#include "databuffer.h"
+#include "loopobex.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(HAVE_PTHREAD) && !defined(_WIN32)
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The two handles of a pair are linked by one ring buffer per direction.
+ * Each ring has exactly one producer and one consumer, so the data path
+ * only needs atomic updates of the ring positions. A side that has to wait
+ * spins shortly and then sleeps on the condition variable of the link. The
+ * other side only takes the lock to wake it up when somebody sleeps. */
+
+/* Bytes per direction, must be a power of 2 */
+#define LOOPOBEX_RING_SIZE (1 << 17)
+
+/* Checks before a waiting side goes to sleep */
+#define LOOPOBEX_SPIN 256
+
+#define LOOPOBEX_WRITE_VEC_MAX 8
+
+#define LOOPOBEX_CACHELINE 64
+
+struct loopobex_ring {
+	/* bytes written so far, only changed by the producer */
+	size_t head;
+	uint8_t pad1[LOOPOBEX_CACHELINE - sizeof(size_t)];
+	/* bytes read so far, only changed by the consumer */
+	size_t tail;
+	uint8_t pad2[LOOPOBEX_CACHELINE - sizeof(size_t)];
+	uint8_t *data;
+};
+
+struct loopobex_link {
+	struct loopobex_ring ring[2];	/* indexed by the producing side */
+	int refs;
+	int closed;
+	int waiters;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct loopobex_data {
+	struct loopobex_link *link;
+	unsigned int side;
+};
+
+static struct obex_transport_ops loopobex_transport_ops;
+
+static size_t ring_used(struct loopobex_ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) -
+		__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+}
+
+static size_t ring_free(struct loopobex_ring *ring)
+{
+	return LOOPOBEX_RING_SIZE - ring_used(ring);
+}
+
+static struct loopobex_link * link_new(void)
+{
+	struct loopobex_link *link = calloc(1, sizeof(*link));
+	int i;
+
+	if (link == NULL)
+		return NULL;
+
+	for (i = 0; i < 2; ++i) {
+		link->ring[i].data = malloc(LOOPOBEX_RING_SIZE);
+		if (link->ring[i].data == NULL)
+			goto err;
+	}
+
+	if (pthread_mutex_init(&link->lock, NULL) != 0)
+		goto err;
+	if (pthread_cond_init(&link->cond, NULL) != 0) {
+		pthread_mutex_destroy(&link->lock);
+		goto err;
+	}
+
+	link->refs = 2;
+	return link;
+
+err:
+	free(link->ring[0].data);
+	free(link->ring[1].data);
+	free(link);
+	return NULL;
+}
+
+static void link_unref(struct loopobex_link *link)
+{
+	if (__atomic_sub_fetch(&link->refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	pthread_cond_destroy(&link->cond);
+	pthread_mutex_destroy(&link->lock);
+	free(link->ring[0].data);
+	free(link->ring[1].data);
+	free(link);
+}
+
+/** Wake up the other side if it sleeps */
+static void link_notify(struct loopobex_link *link)
+{
+	if (__atomic_load_n(&link->waiters, __ATOMIC_SEQ_CST) == 0)
+		return;
+
+	pthread_mutex_lock(&link->lock);
+	pthread_cond_broadcast(&link->cond);
+	pthread_mutex_unlock(&link->lock);
+}
+
+static bool link_can_read(struct loopobex_data *data)
+{
+	struct loopobex_link *link = data->link;
+
+	return (ring_used(&link->ring[!data->side]) != 0 ||
+		__atomic_load_n(&link->closed, __ATOMIC_SEQ_CST));
+}
+
+static bool link_can_write(struct loopobex_data *data)
+{
+	struct loopobex_link *link = data->link;
+
+	return (ring_free(&link->ring[data->side]) != 0 ||
+		__atomic_load_n(&link->closed, __ATOMIC_SEQ_CST));
+}
+
+/** Wait until a condition is true
+ * @param timeout time to wait in milliseconds, -1 to wait forever
+ * @return the condition
+ */
+static bool link_wait(struct loopobex_data *data,
+		      bool (*ready)(struct loopobex_data *), int64_t timeout)
+{
+	struct loopobex_link *link = data->link;
+	struct timespec deadline;
+	bool ok;
+	int i;
+
+	for (i = 0; i < LOOPOBEX_SPIN; ++i) {
+		if (ready(data))
+			return true;
+		if (timeout == 0)
+			return false;
+	}
+
+	if (timeout > 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)(timeout / 1000);
+		deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&link->lock);
+	__atomic_add_fetch(&link->waiters, 1, __ATOMIC_SEQ_CST);
+	while (!(ok = ready(data))) {
+		if (timeout < 0)
+			pthread_cond_wait(&link->cond, &link->lock);
+		else if (pthread_cond_timedwait(&link->cond, &link->lock,
+						&deadline) == ETIMEDOUT) {
+			ok = ready(data);
+			break;
+		}
+	}
+	__atomic_sub_fetch(&link->waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&link->lock);
+
+	return ok;
+}
+
+static void link_close(struct loopobex_data *data)
+{
+	struct loopobex_link *link = data->link;
+
+	if (link == NULL)
+		return;
+
+	__atomic_store_n(&link->closed, 1, __ATOMIC_SEQ_CST);
+	link_notify(link);
+	link_unref(link);
+	data->link = NULL;
+}
+
+static void * loopobex_create(void)
+{
+	return calloc(1, sizeof(struct loopobex_data));
+}
+
+static bool loopobex_init(obex_t *self)
+{
+	return (self->trans->data != NULL);
+}
+
+static void loopobex_cleanup(obex_t *self)
+{
+	struct loopobex_data *data = self->trans->data;
+
+	link_close(data);
+	free(data);
+}
+
+/*
+ * Function loopobex_pair (self, peer)
+ *
+ *    Link two loopback handles with each other
+ *
+ */
+int loopobex_pair(obex_t *self, obex_t *peer)
+{
+	struct loopobex_data *data, *peer_data;
+	struct loopobex_link *link;
+
+	if (self == peer ||
+	    self->trans->ops != &loopobex_transport_ops ||
+	    peer->trans->ops != &loopobex_transport_ops)
+		return -EINVAL;
+
+	data = self->trans->data;
+	peer_data = peer->trans->data;
+	if (data->link || peer_data->link ||
+	    self->trans->connected || peer->trans->connected)
+		return -EISCONN;
+
+	link = link_new();
+	if (link == NULL)
+		return -ENOMEM;
+
+	data->link = link;
+	data->side = 0;
+	peer_data->link = link;
+	peer_data->side = 1;
+
+	if (!obex_transport_connect_request(self) ||
+	    !obex_transport_connect_request(peer))
+		return -ENOTCONN;
+
+	return 0;
+}
+
+static bool loopobex_connect_request(obex_t *self)
+{
+	struct loopobex_data *data = self->trans->data;
+
+	return (data->link != NULL);
+}
+
+static bool loopobex_disconnect(obex_t *self)
+{
+	struct loopobex_data *data = self->trans->data;
+
+	DEBUG(4, "\n");
+
+	link_close(data);
+	return true;
+}
+
+static result_t loopobex_handle_input(obex_t *self)
+{
+	struct loopobex_data *data = self->trans->data;
+
+	if (data->link == NULL)
+		return RESULT_ERROR;
+
+	if (link_wait(data, &link_can_read, self->trans->timeout))
+		return RESULT_SUCCESS;
+	else
+		return RESULT_TIMEOUT;
+}
+
+/** Copy file data straight into the ring */
+static ssize_t ring_put_file(uint8_t *dst, size_t len,
+			     const struct databuffer_vec *vec, size_t done)
+{
+	ssize_t ret;
+
+	if (len > vec->len - done)
+		len = vec->len - done;
+
+	ret = pread(vec->fd, dst, len, (off_t)(vec->offset + done));
+	if (ret == 0) {
+		errno = EIO;
+		return -1;
+	}
+	return ret;
+}
+
+static ssize_t loopobex_write(obex_t *self, struct databuffer *msg)
+{
+	struct loopobex_data *data = self->trans->data;
+	struct databuffer_vec vec[LOOPOBEX_WRITE_VEC_MAX];
+	struct loopobex_ring *ring;
+	size_t head, room, total = 0;
+	int i, n;
+
+	if (data->link == NULL)
+		return -1;
+
+	if (!link_wait(data, &link_can_write, self->trans->timeout))
+		return 0;
+	if (__atomic_load_n(&data->link->closed, __ATOMIC_SEQ_CST))
+		return -1;
+
+	ring = &data->link->ring[data->side];
+	head = ring->head;
+	room = ring_free(ring);
+
+	n = buf_get_vec(msg, vec, LOOPOBEX_WRITE_VEC_MAX);
+	for (i = 0; i < n && room; ++i) {
+		size_t done = 0;
+
+		while (done < vec[i].len && room) {
+			size_t pos = head & (LOOPOBEX_RING_SIZE - 1);
+			size_t len = LOOPOBEX_RING_SIZE - pos;
+
+			if (len > room)
+				len = room;
+			if (len > vec[i].len - done)
+				len = vec[i].len - done;
+
+			if (vec[i].base == NULL) {
+				ssize_t ret = ring_put_file(ring->data + pos,
+							    len, &vec[i], done);
+				if (ret < 0) {
+					if (total)
+						break;
+					return -1;
+				}
+				len = (size_t)ret;
+			} else
+				memcpy(ring->data + pos,
+				       (const uint8_t *)vec[i].base + done, len);
+
+			head += len;
+			room -= len;
+			done += len;
+			total += len;
+		}
+		if (done < vec[i].len)
+			break;
+	}
+
+	__atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+	link_notify(data->link);
+
+	return (ssize_t)total;
+}
+
+static ssize_t loopobex_read(obex_t *self, void *buf, int buflen)
+{
+	struct loopobex_data *data = self->trans->data;
+	struct loopobex_ring *ring;
+	size_t tail, len, pos, part;
+
+	if (data->link == NULL)
+		return -1;
+
+	ring = &data->link->ring[!data->side];
+	len = ring_used(ring);
+	if (len == 0)
+		return __atomic_load_n(&data->link->closed,
+				       __ATOMIC_SEQ_CST)? -1: 0;
+	if (len > (size_t)buflen)
+		len = (size_t)buflen;
+
+	tail = ring->tail;
+	pos = tail & (LOOPOBEX_RING_SIZE - 1);
+	part = LOOPOBEX_RING_SIZE - pos;
+	if (part > len)
+		part = len;
+	memcpy(buf, ring->data + pos, part);
+	memcpy((uint8_t *)buf + part, ring->data, len - part);
+
+	__atomic_store_n(&ring->tail, tail + len, __ATOMIC_SEQ_CST);
+	link_notify(data->link);
+
+	return (ssize_t)len;
+}
+
+static struct obex_transport_ops loopobex_transport_ops = {
+	&loopobex_create,
+	&loopobex_init,
+	&loopobex_cleanup,
+
+	&loopobex_handle_input,
+	&loopobex_write,
+	&loopobex_read,
+	NULL,
+	&loopobex_disconnect,
+
+	NULL,
+	NULL,
+	NULL,
+
+	{
+		NULL,
+		NULL,
+	},
+
+	{
+		&loopobex_connect_request,
+		NULL,
+		NULL,
+		NULL,
+	},
+};
+
+struct obex_transport * loopobex_transport_create(void)
+{
+	return obex_transport_create(&loopobex_transport_ops);
+}
+
+#else /* HAVE_PTHREAD */
+
+struct obex_transport * loopobex_transport_create(void)
+{
+	return NULL;
+}
+
+int loopobex_pair(obex_t *self, obex_t *peer)
+{
+	return -ENOSYS;
+}
+
+#endif /* HAVE_PTHREAD */
@@ -0,0 +1,26 @@
+/**
+	\file loopobex.h
+	LoopOBEX, in-process loopback transport for OBEX.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef LOOPOBEX_H
+#define LOOPOBEX_H
+
+struct obex_transport * loopobex_transport_create(void);
+int loopobex_pair(obex_t *self, obex_t *peer);
+
+#endif
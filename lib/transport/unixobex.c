@@ -0,0 +1,416 @@
+/**
+	\file unixobex.c
+	UnixOBEX, local socket transport for OBEX.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "obex_main.h"
+#include "unixobex.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "obex_transport_sock.h"
+
+/* Number of received descriptors that are kept until the application
+ * takes them */
+#define UNIXOBEX_RECV_FDS 16
+
+struct unixobex_data {
+	struct obex_sock *sock;
+	int pass_fds[OBEX_SOCK_MAX_FDS];	/* sent with the next message */
+	unsigned int pass_count;
+	int recv_fds[UNIXOBEX_RECV_FDS];	/* received, not taken yet */
+	unsigned int recv_count;
+};
+
+static struct obex_transport_ops unixobex_transport_ops;
+
+static bool is_unixobex(obex_t *self)
+{
+	return (self->trans && self->trans->ops == &unixobex_transport_ops);
+}
+
+static void * unixobex_create(void)
+{
+	return calloc(1, sizeof(struct unixobex_data));
+}
+
+static bool unixobex_init(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	if (data == NULL)
+		return false;
+
+	data->sock = obex_transport_sock_create(AF_UNIX, 0,
+						sizeof(struct sockaddr_un),
+						self->init_flags);
+	if (data->sock == NULL) {
+		free(data);
+		return false;
+	}
+
+	return true;
+}
+
+static void unixobex_close_fds(struct unixobex_data *data)
+{
+	unsigned int i;
+
+	for (i = 0; i < data->pass_count; ++i)
+		(void)close(data->pass_fds[i]);
+	data->pass_count = 0;
+
+	for (i = 0; i < data->recv_count; ++i)
+		(void)close(data->recv_fds[i]);
+	data->recv_count = 0;
+}
+
+static void unixobex_cleanup(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	unixobex_close_fds(data);
+	if (data->sock)
+		obex_transport_sock_destroy(data->sock);
+	free(data);
+}
+
+/** Fill a local socket address
+ * A path starting with '@' names a socket in the abstract namespace
+ * (Linux only).
+ */
+static bool unixobex_make_addr(struct sockaddr_un *addr, const char *path)
+{
+	size_t len = strlen(path);
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+
+	if (len == 0 || len >= sizeof(addr->sun_path))
+		return false;
+
+#ifdef __linux__
+	if (path[0] == '@') {
+		memcpy(addr->sun_path + 1, path + 1, len - 1);
+		return true;
+	}
+#endif
+
+	memcpy(addr->sun_path, path, len);
+	return true;
+}
+
+static bool unixobex_set_type(obex_t *self, int type)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	switch (type) {
+	case 0:
+	case SOCK_STREAM:
+		data->sock->type = SOCK_STREAM;
+		self->tx_record = 0;
+		return true;
+
+	case SOCK_SEQPACKET:
+		/* A record must be read at once, so the reads must be large
+		 * enough for any packet. The peer reads at least that much,
+		 * so SRM batches must not be larger. */
+		data->sock->type = SOCK_SEQPACKET;
+		if (self->rx_readahead < OBEX_MAXIMUM_MTU)
+			self->rx_readahead = OBEX_MAXIMUM_MTU;
+		self->tx_record = OBEX_MAXIMUM_MTU;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static bool unixobex_set_remote_addr(obex_t *self, struct sockaddr *addr,
+				     size_t len)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	return obex_transport_sock_set_remote(data->sock, addr,
+					      (socklen_t)len);
+}
+
+static bool unixobex_set_local_addr(obex_t *self, struct sockaddr *addr,
+				    size_t len)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	return obex_transport_sock_set_local(data->sock, addr, (socklen_t)len);
+}
+
+/*
+ * Function unixobex_prepare_connect (self, path, type)
+ *
+ *    Prepare for a local connect
+ *
+ */
+bool unixobex_prepare_connect(obex_t *self, const char *path, int type)
+{
+	struct unixobex_data *data;
+	struct sockaddr_un addr;
+
+	if (!is_unixobex(self) || !unixobex_make_addr(&addr, path) ||
+	    !unixobex_set_type(self, type))
+		return false;
+
+	data = self->trans->data;
+	return obex_transport_sock_set_remote(data->sock,
+					      (struct sockaddr *)&addr,
+					      sizeof(addr));
+}
+
+/*
+ * Function unixobex_prepare_listen (self, path, type)
+ *
+ *    Prepare for a local listen
+ *
+ */
+bool unixobex_prepare_listen(obex_t *self, const char *path, int type)
+{
+	struct unixobex_data *data;
+	struct sockaddr_un addr;
+
+	if (!is_unixobex(self) || !unixobex_make_addr(&addr, path) ||
+	    !unixobex_set_type(self, type))
+		return false;
+
+	data = self->trans->data;
+	return obex_transport_sock_set_local(data->sock,
+					     (struct sockaddr *)&addr,
+					     sizeof(addr));
+}
+
+/*
+ * Function unixobex_pass_fd (self, fd)
+ *
+ *    Queue a copy of a descriptor to be sent with the next message
+ *
+ */
+int unixobex_pass_fd(obex_t *self, int fd)
+{
+	struct unixobex_data *data;
+	int copy;
+
+	if (!is_unixobex(self))
+		return -ESOCKTNOSUPPORT;
+
+	data = self->trans->data;
+	if (data->pass_count >= OBEX_SOCK_MAX_FDS)
+		return -ENOSPC;
+
+	copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (copy == -1)
+		return -errno;
+
+	data->pass_fds[data->pass_count++] = copy;
+	return 0;
+}
+
+/*
+ * Function unixobex_get_passed_fd (self)
+ *
+ *    Take the oldest descriptor that was received
+ *
+ */
+int unixobex_get_passed_fd(obex_t *self)
+{
+	struct unixobex_data *data;
+	int fd;
+
+	if (!is_unixobex(self))
+		return -ESOCKTNOSUPPORT;
+
+	data = self->trans->data;
+	if (data->recv_count == 0)
+		return -ENOENT;
+
+	fd = data->recv_fds[0];
+	--data->recv_count;
+	memmove(data->recv_fds, data->recv_fds + 1,
+		data->recv_count * sizeof(*data->recv_fds));
+	return fd;
+}
+
+/*
+ * Function unixobex_listen (self)
+ *
+ *    Wait for incomming connections
+ *
+ */
+static bool unixobex_listen(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	DEBUG(4, "\n");
+
+	return obex_transport_sock_listen(data->sock, self->trans->backlog);
+}
+
+/*
+ * Function unixobex_accept (self)
+ *
+ *    Accept incoming connection.
+ *
+ */
+static bool unixobex_accept(obex_t *self, const obex_t *server)
+{
+	struct unixobex_data *server_data = server->trans->data;
+	struct unixobex_data *data = self->trans->data;
+
+	if (data == NULL)
+		return false;
+
+	data->sock = obex_transport_sock_accept(server_data->sock);
+	if (data->sock == NULL)
+		return false;
+
+	return true;
+}
+
+/*
+ * Function unixobex_connect_request (self)
+ */
+static bool unixobex_connect_request(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	DEBUG(4, "\n");
+
+	return obex_transport_sock_connect(data->sock);
+}
+
+/*
+ * Function unixobex_disconnect (self)
+ *
+ *    Shutdown the local link
+ *
+ */
+static bool unixobex_disconnect(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	DEBUG(4, "\n");
+
+	unixobex_close_fds(data);
+	return obex_transport_sock_disconnect(data->sock);
+}
+
+static result_t unixobex_handle_input(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	DEBUG(4, "\n");
+
+	return obex_transport_sock_wait(data->sock, self->trans->timeout);
+}
+
+static ssize_t unixobex_write(obex_t *self, struct databuffer *msg)
+{
+	struct obex_transport *trans = self->trans;
+	struct unixobex_data *data = self->trans->data;
+	unsigned int nfds = data->pass_count;
+	ssize_t ret;
+	unsigned int i;
+
+	DEBUG(4, "\n");
+
+	ret = obex_transport_sock_send_fds(data->sock, msg, trans->timeout,
+					   false, data->pass_fds, &nfds);
+	if (nfds == 0)
+		return ret;
+
+	/* The receiver has its own copies now */
+	for (i = 0; i < nfds; ++i)
+		(void)close(data->pass_fds[i]);
+	data->pass_count = 0;
+
+	return ret;
+}
+
+static ssize_t unixobex_read(obex_t *self, void *buf, int buflen)
+{
+	struct unixobex_data *data = self->trans->data;
+	unsigned int nfds = UNIXOBEX_RECV_FDS - data->recv_count;
+	ssize_t ret;
+
+	DEBUG(4, "\n");
+
+	ret = obex_transport_sock_recv_fds(data->sock, buf, buflen,
+					   data->recv_fds + data->recv_count,
+					   &nfds);
+	data->recv_count += nfds;
+
+	return ret;
+}
+
+static int unixobex_get_fd(obex_t *self)
+{
+	struct unixobex_data *data = self->trans->data;
+
+	return (int)obex_transport_sock_get_fd(data->sock);
+}
+
+static struct obex_transport_ops unixobex_transport_ops = {
+	&unixobex_create,
+	&unixobex_init,
+	&unixobex_cleanup,
+
+	&unixobex_handle_input,
+	&unixobex_write,
+	&unixobex_read,
+	NULL,
+	&unixobex_disconnect,
+
+	&unixobex_get_fd,
+	&unixobex_set_local_addr,
+	&unixobex_set_remote_addr,
+
+	{
+		&unixobex_listen,
+		&unixobex_accept,
+	},
+
+	{
+		&unixobex_connect_request,
+		NULL,
+		NULL,
+		NULL,
+	},
+};
+
+struct obex_transport * unixobex_transport_create(void)
+{
+	return obex_transport_create(&unixobex_transport_ops);
+}
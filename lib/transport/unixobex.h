@@ -0,0 +1,29 @@
+/**
+	\file unixobex.h
+	UnixOBEX, local socket transport for OBEX.
+	OpenOBEX library - Free implementation of the Object Exchange protocol.
+
+	OpenOBEX is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with OpenOBEX. If not, see <http://www.gnu.org/>.
+ */
+
+#ifndef UNIXOBEX_H
+#define UNIXOBEX_H
+
+struct obex_transport * unixobex_transport_create(void);
+bool unixobex_prepare_connect(obex_t *self, const char *path, int type);
+bool unixobex_prepare_listen(obex_t *self, const char *path, int type);
+int unixobex_pass_fd(obex_t *self, int fd);
+int unixobex_get_passed_fd(obex_t *self);
+
+#endif
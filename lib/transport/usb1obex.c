@@ -39,6 +39,17 @@
 #include "usbobex.h"
 #include "usbutils.h"
 #include "databuffer.h"
+#include "monotime.h"
+
+/* An asynchronous bulk transfer and the buffer that it uses */
+struct usbobex_xfer {
+	struct libusb_transfer *transfer;
+	uint8_t *buf;
+	size_t size;
+	bool busy;			/* submitted and not completed yet */
+};
+
+static struct obex_transport_ops usbobex_transport_ops;
 
 static void usbobex_set_fd(int fd, short events, void *user_data)
 {
@@ -404,6 +415,219 @@ static void usbobex_free_interface(obex_interface_t *intf)
 	}
 }
 
+/*
+ * Function usbobex_set_transfers (self, rx, tx)
+ *
+ *    Set the number of asynchronous transfers, 0 for synchronous transfers
+ *
+ */
+int usbobex_set_transfers(obex_t *self, unsigned int rx, unsigned int tx)
+{
+	struct usbobex_data *data;
+
+	if (self->trans->ops != &usbobex_transport_ops)
+		return -ESOCKTNOSUPPORT;
+
+	if (self->trans->connected)
+		return -EISCONN;
+
+	if (rx > USBOBEX_MAX_TRANSFERS || tx > USBOBEX_MAX_TRANSFERS ||
+	    (rx == 0) != (tx == 0))
+		return -EINVAL;
+
+	data = self->trans->data;
+	data->rx_count = rx;
+	data->tx_count = tx;
+	return 0;
+}
+
+static void LIBUSB_CALL usbobex_xfer_done(struct libusb_transfer *transfer)
+{
+	struct usbobex_xfer *xfer = transfer->user_data;
+
+	xfer->busy = false;
+}
+
+static int usbobex_xfer_submit(struct usbobex_xfer *xfer)
+{
+	int ret;
+
+	xfer->busy = true;
+	ret = libusb_submit_transfer(xfer->transfer);
+	if (ret != 0) {
+		DEBUG(1, "Submitting transfer failed %d\n", ret);
+		xfer->busy = false;
+	}
+	return ret;
+}
+
+/** Handle libusb events until a transfer is not busy anymore
+ * @param timeout time to wait in milliseconds, -1 to wait forever
+ * @return 1 when done, 0 on timeout, -1 on error
+ */
+static int usbobex_xfer_wait(struct usbobex_data *data,
+			     struct usbobex_xfer *xfer, int64_t timeout)
+{
+	int64_t end = obex_monotime_ms() + (timeout > 0? timeout: 0);
+
+	while (xfer->busy) {
+		struct timeval tv;
+		int64_t left = 1000;
+
+		if (timeout >= 0) {
+			left = end - obex_monotime_ms();
+			if (left < 0)
+				left = 0;
+		}
+
+		tv.tv_sec = (time_t)(left / 1000);
+		tv.tv_usec = (long)(left % 1000) * 1000;
+		if (libusb_handle_events_timeout(data->ctx, &tv) < 0)
+			return -1;
+
+		if (xfer->busy && timeout >= 0 && left == 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void usbobex_xfers_free(struct usbobex_data *data,
+			       struct usbobex_xfer *xfers, unsigned int count)
+{
+	unsigned int i;
+	int tries = 10;
+
+	if (xfers == NULL)
+		return;
+
+	for (i = 0; i < count; ++i) {
+		if (xfers[i].busy)
+			libusb_cancel_transfer(xfers[i].transfer);
+	}
+
+	/* The transfers must be completed before they can be freed */
+	for (i = 0; i < count; ++i) {
+		while (xfers[i].busy && tries > 0) {
+			if (usbobex_xfer_wait(data, &xfers[i], 100) == 0)
+				--tries;
+		}
+	}
+
+	for (i = 0; i < count; ++i) {
+		if (xfers[i].busy) {
+			/* Leaking is better than a late callback */
+			DEBUG(1, "Transfer %u did not finish\n", i);
+			continue;
+		}
+		if (xfers[i].transfer)
+			libusb_free_transfer(xfers[i].transfer);
+		free(xfers[i].buf);
+	}
+	free(xfers);
+}
+
+static struct usbobex_xfer * usbobex_xfers_new(unsigned int count)
+{
+	struct usbobex_xfer *xfers = calloc(count, sizeof(*xfers));
+	unsigned int i;
+
+	if (xfers == NULL)
+		return NULL;
+
+	for (i = 0; i < count; ++i) {
+		xfers[i].transfer = libusb_alloc_transfer(0);
+		if (xfers[i].transfer == NULL)
+			break;
+		xfers[i].transfer->user_data = &xfers[i];
+		xfers[i].transfer->status = LIBUSB_TRANSFER_COMPLETED;
+	}
+	if (i < count) {
+		while (i-- > 0)
+			libusb_free_transfer(xfers[i].transfer);
+		free(xfers);
+		return NULL;
+	}
+
+	return xfers;
+}
+
+/** Stop asynchronous transfers
+ * Outgoing data is given the transport timeout, but not more than
+ * USBOBEX_STOP_TIMEOUT, to be sent.
+ */
+static void usbobex_async_stop(obex_t *self)
+{
+	struct usbobex_data *data = self->trans->data;
+	int64_t timeout = self->trans->timeout;
+	int64_t end;
+	unsigned int i;
+
+	if (timeout < 0 || timeout > USBOBEX_STOP_TIMEOUT)
+		timeout = USBOBEX_STOP_TIMEOUT;
+	end = obex_monotime_ms() + timeout;
+
+	for (i = 0; data->tx && i < data->tx_count; ++i) {
+		struct usbobex_xfer *xfer = &data->tx[(data->tx_next + i) %
+						      data->tx_count];
+		int64_t left = end - obex_monotime_ms();
+
+		if (usbobex_xfer_wait(data, xfer, left > 0? left: 0) != 1)
+			break;
+	}
+
+	usbobex_xfers_free(data, data->rx, data->rx_count);
+	usbobex_xfers_free(data, data->tx, data->tx_count);
+	data->rx = NULL;
+	data->tx = NULL;
+}
+
+/** Start asynchronous transfers
+ * All IN transfers are queued right away, so the device can send while
+ * the last packet is processed.
+ */
+static bool usbobex_async_start(obex_t *self)
+{
+	struct usbobex_data *data = self->trans->data;
+	unsigned int i;
+
+	data->rx_next = 0;
+	data->tx_next = 0;
+	data->rx_offset = 0;
+	data->error = false;
+
+	if (data->rx_count == 0)
+		return true;
+
+	data->rx = usbobex_xfers_new(data->rx_count);
+	data->tx = usbobex_xfers_new(data->tx_count);
+	if (data->rx == NULL || data->tx == NULL)
+		goto err;
+
+	for (i = 0; i < data->rx_count; ++i) {
+		struct usbobex_xfer *xfer = &data->rx[i];
+
+		/* USB can only read 0xFFFF bytes at once (equals mtu_rx) */
+		xfer->size = self->mtu_rx;
+		xfer->buf = malloc(xfer->size);
+		if (xfer->buf == NULL)
+			goto err;
+
+		libusb_fill_bulk_transfer(xfer->transfer, data->self.dev,
+					  data->self.data_endpoint_read,
+					  xfer->buf, (int)xfer->size,
+					  &usbobex_xfer_done, xfer, 0);
+		if (usbobex_xfer_submit(xfer) != 0)
+			goto err;
+	}
+
+	return true;
+
+err:
+	usbobex_async_stop(self);
+	return false;
+}
+
 /*
  * Function usbobex_connect_request (self)
  *
@@ -450,6 +674,11 @@ static bool usbobex_connect_request(obex_t *self)
 		goto err3;
 	}
 
+	if (!usbobex_async_start(self)) {
+		DEBUG(4, "Can't start asynchronous transfers");
+		goto err3;
+	}
+
 	return true;
 
 err3:
@@ -474,6 +703,8 @@ static bool usbobex_disconnect(obex_t *self)
 
 	DEBUG(4, "\n");
 
+	usbobex_async_stop(self);
+
 	libusb_clear_halt(data->self.dev, data->self.data_endpoint_read);
 	libusb_clear_halt(data->self.dev, data->self.data_endpoint_write);
 
@@ -513,6 +744,52 @@ static unsigned int usbobex_get_timeout(int64_t timeout)
 	return 0;
 }
 
+/** Queue the message as an OUT transfer
+ * This only waits if all OUT transfers are in flight.
+ */
+static ssize_t usbobex_write_async(obex_t *self, struct databuffer *msg)
+{
+	struct usbobex_data *data = self->trans->data;
+	struct usbobex_xfer *xfer = &data->tx[data->tx_next];
+	size_t len = buf_get_length(msg);
+	int ret;
+
+	if (data->error)
+		return -1;
+
+	ret = usbobex_xfer_wait(data, xfer, self->trans->timeout);
+	if (ret <= 0)
+		return ret;
+
+	/* Errors of earlier writes are reported late */
+	if (xfer->transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		DEBUG(1, "Transfer failed %d\n", xfer->transfer->status);
+		data->error = true;
+		return -1;
+	}
+
+	if (xfer->size < len) {
+		uint8_t *buf = realloc(xfer->buf, len);
+
+		if (buf == NULL)
+			return -1;
+		xfer->buf = buf;
+		xfer->size = len;
+	}
+	memcpy(xfer->buf, buf_get(msg), len);
+
+	libusb_fill_bulk_transfer(xfer->transfer, data->self.dev,
+				  data->self.data_endpoint_write,
+				  xfer->buf, (int)len,
+				  &usbobex_xfer_done, xfer, 0);
+	if (usbobex_xfer_submit(xfer) != 0)
+		return -1;
+
+	data->tx_next = (data->tx_next + 1) % data->tx_count;
+	buf_clear(msg, len);
+	return (ssize_t)len;
+}
+
 static ssize_t usbobex_write(obex_t *self, struct databuffer *msg)
 {
 	struct obex_transport *trans = self->trans;
@@ -521,6 +798,9 @@ static ssize_t usbobex_write(obex_t *self, struct databuffer *msg)
 	int usberror;
 
 	DEBUG(4, "Endpoint %d\n", data->self.data_endpoint_write);
+	if (data->tx)
+		return usbobex_write_async(self, msg);
+
 	usberror = libusb_bulk_transfer(data->self.dev,
 					data->self.data_endpoint_write,
 					buf_get(msg),
@@ -540,6 +820,61 @@ static ssize_t usbobex_write(obex_t *self, struct databuffer *msg)
 	}
 }
 
+/** Take data from the oldest IN transfer
+ * The transfer is queued again once all of its data was read.
+ */
+static ssize_t usbobex_read_async(obex_t *self, void *buf)
+{
+	struct usbobex_data *data = self->trans->data;
+	struct usbobex_xfer *xfer;
+	struct libusb_transfer *transfer;
+	size_t len;
+	int ret;
+
+	if (data->error)
+		return -1;
+
+	for (;;) {
+		xfer = &data->rx[data->rx_next];
+		ret = usbobex_xfer_wait(data, xfer, self->trans->timeout);
+		if (ret <= 0)
+			return ret;
+
+		transfer = xfer->transfer;
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+			DEBUG(1, "Transfer failed %d\n", transfer->status);
+			data->error = true;
+			return -1;
+		}
+
+		/* Zero length packets only end a transfer */
+		if (transfer->actual_length > 0)
+			break;
+
+		if (usbobex_xfer_submit(xfer) != 0) {
+			data->error = true;
+			return -1;
+		}
+		data->rx_next = (data->rx_next + 1) % data->rx_count;
+	}
+
+	len = (size_t)transfer->actual_length - data->rx_offset;
+	if (len > self->mtu_rx)
+		len = self->mtu_rx;
+	memcpy(buf, xfer->buf + data->rx_offset, len);
+	data->rx_offset += len;
+
+	if (data->rx_offset == (size_t)transfer->actual_length) {
+		data->rx_offset = 0;
+		data->rx_next = (data->rx_next + 1) % data->rx_count;
+		/* The data is returned anyway, the error comes next time */
+		if (usbobex_xfer_submit(xfer) != 0)
+			data->error = true;
+	}
+
+	return (ssize_t)len;
+}
+
 static ssize_t usbobex_read(obex_t *self, void *buf, int buflen)
 {
 	struct obex_transport *trans = self->trans;
@@ -549,6 +884,9 @@ static ssize_t usbobex_read(obex_t *self, void *buf, int buflen)
 
 	/* USB can only read 0xFFFF bytes at once (equals mtu_rx) */
 	DEBUG(4, "Endpoint %d\n", data->self.data_endpoint_read);
+	if (data->rx)
+		return usbobex_read_async(self, buf);
+
 	usberror = libusb_bulk_transfer(data->self.dev,
 					data->self.data_endpoint_read,
 					buf, self->mtu_rx, &actual,
@@ -571,6 +909,20 @@ static ssize_t usbobex_read(obex_t *self, void *buf, int buflen)
 	return actual;
 }
 
+/** Check if an IN transfer completed without being read
+ * Transfers also complete while libusb events are handled for other
+ * transfers. The poll descriptors do not show that anymore.
+ */
+static bool usbobex_input_queued(obex_t *self)
+{
+	struct usbobex_data *data = self->trans->data;
+
+	if (data->rx == NULL)
+		return false;
+
+	return (data->error || !data->rx[data->rx_next].busy);
+}
+
 static result_t usbobex_handle_input(obex_t *self)
 {
 	ssize_t err = obex_transport_read(self, 0);
@@ -590,6 +942,7 @@ static struct obex_transport_ops usbobex_transport_ops = {
 	&usbobex_handle_input,
 	&usbobex_write,
 	&usbobex_read,
+	&usbobex_input_queued,
 	&usbobex_disconnect,
 
 	&usbobex_get_fd,
@@ -541,6 +541,7 @@ static struct obex_transport_ops usbobex_transport_ops = {
 	usbobex_handle_input,
 	&usbobex_write,
 	&usbobex_read,
+	NULL,
 	&usbobex_disconnect,
 
 	NULL,
@@ -99,12 +99,33 @@ struct cdc_union_desc {
 
 #define USB_MAX_STRING_SIZE		256
 
+/* Maximum number of queued asynchronous transfers per direction */
+#define USBOBEX_MAX_TRANSFERS		32
+
+/* Longest time in milliseconds to wait for OUT transfers when stopping */
+#define USBOBEX_STOP_TIMEOUT		1000
+
 struct obex_transport * usbobex_transport_create(void);
+#ifdef HAVE_USB1
+int usbobex_set_transfers(obex_t *self, unsigned int rx, unsigned int tx);
+
+struct usbobex_xfer;
+#endif
 
 struct usbobex_data {
 #ifdef HAVE_USB1
 	struct libusb_context *ctx;
 	int fd;
+
+	/* Asynchronous transfers, none of them in synchronous mode */
+	unsigned int rx_count;		/* IN transfers kept queued */
+	unsigned int tx_count;		/* OUT transfers in flight at most */
+	struct usbobex_xfer *rx;	/* IN transfers in submission order */
+	struct usbobex_xfer *tx;	/* OUT transfers in submission order */
+	unsigned int rx_next;		/* IN transfer that completes next */
+	unsigned int tx_next;		/* OUT transfer that is used next */
+	size_t rx_offset;		/* bytes of rx_next that were read */
+	bool error;			/* an asynchronous transfer failed */
 #endif
 	struct obex_usb_intf_transport_t self;
 };